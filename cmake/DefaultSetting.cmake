@@ -35,4 +35,22 @@ endfunction()
 
 macro(default_arch_setting TARGET DEFINITION DEFAULT_VALUE)
     default_compile_setting(${TARGET} ${CMAKE_SYSTEM_PROCESSOR}_${DEFINITION} ${DEFAULT_VALUE})
-endmacro()
\ No newline at end of file
+endmacro()
+
+# Like default_compile_setting(), but for the settings the public headers depend on: they are not passed on the command
+# line, but written to the generated cco/config.h, so that the users of the library see the same values
+function(public_compile_setting TARGET DEFINITION DEFAULT_VALUE)
+    set(${DEFINITION}_DEFAULT ${DEFAULT_VALUE})
+    if(NOT DEFINED ${DEFINITION})
+        if(${CMAKE_VERBOSE_SETTINGS})
+            message(STATUS "${DEFINITION} set to default value of ${${DEFINITION}_DEFAULT}")
+        endif()
+        set(${DEFINITION} ${${DEFINITION}_DEFAULT})
+    else()
+        if(${CMAKE_VERBOSE_SETTINGS})
+            message(STATUS "${DEFINITION} set to ${${DEFINITION}}")
+        endif()
+    endif()
+    get_property(opts GLOBAL PROPERTY ${TARGET}_PUBLIC_SETTINGS)
+    set_property(GLOBAL PROPERTY ${TARGET}_PUBLIC_SETTINGS "${opts};${DEFINITION}=${${DEFINITION}}")
+endfunction()
@@ -26,15 +26,17 @@ default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} ENABLE_AVX512_REGISTERS_
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} ENABLE_SEGMENT_REGISTERS_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} ENABLE_DEBUG_REGISTERS_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} ENABLE_CONTROL_REGISTERS_EXCHANGE 0)
+default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} ENABLE_FP_CONTROL_REGISTERS_EXCHANGE 1)
 
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} RFLAGS_REGISTER_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} FPU_MMX_REGISTERS_DEFAULT_EXCHANGE 0)
-default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} SSE_REGISTERS_DEFAULT_EXCHANGE 1)
+default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} SSE_REGISTERS_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} AVX_REGISTERS_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} AVX512_REGISTERS_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} SEGMENT_REGISTERS_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} DEBUG_REGISTERS_DEFAULT_EXCHANGE 0)
 default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} CONTROL_REGISTERS_DEFAULT_EXCHANGE 0)
+default_arch_setting(cco_arch_${CMAKE_SYSTEM_PROCESSOR} FP_CONTROL_REGISTERS_DEFAULT_EXCHANGE 0)
 
 add_library(cco_arch_${CMAKE_SYSTEM_PROCESSOR} INTERFACE)
 add_library(cco::arch ALIAS cco_arch_${CMAKE_SYSTEM_PROCESSOR})
@@ -0,0 +1,36 @@
+# cco - coroutine library for C
+# Copyright (C) 2021-2022 Domenico Teodonio
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+if(NOT CCO_TOOLCHAIN_INCLUDED)
+    set(CCO_TOOLCHAIN_INCLUDED TRUE)
+    include(${CMAKE_CURRENT_LIST_DIR}/../DefaultSetting.cmake)
+    include(${CMAKE_CURRENT_LIST_DIR}/../arch/aarch64.cmake)
+
+    set(CMAKE_SYSTEM_NAME Linux)
+    if(CMAKE_HOST_SYSTEM_PROCESSOR STREQUAL "aarch64")
+        set(CMAKE_C_COMPILER gcc)
+        set(CMAKE_CXX_COMPILER g++)
+    else()
+        # Cross compilation, the tests are run through qemu-user with the sysroot of the cross toolchain
+        set(CCO_aarch64_SYSROOT /usr/aarch64-linux-gnu CACHE PATH "Sysroot of the AArch64 cross toolchain")
+        set(CMAKE_C_COMPILER aarch64-linux-gnu-gcc)
+        set(CMAKE_CXX_COMPILER aarch64-linux-gnu-g++)
+        find_program(CCO_QEMU_aarch64 qemu-aarch64)
+        if(CCO_QEMU_aarch64)
+            set(CMAKE_CROSSCOMPILING_EMULATOR ${CCO_QEMU_aarch64} -L ${CCO_aarch64_SYSROOT})
+        endif()
+    endif()
+endif()
@@ -40,11 +40,17 @@ extern "C" {
 /** \endcond */
 
 #include "cco/api.h"
+#include "cco/config.h"
+#include "cco/allocator.h"
 #include "cco/arch.h"
 #include CCO_TARGET_ARCH_HEADER
-#include "cco/coroutine.h"
 #include "cco/errno.h"
+#include "cco/coroutine.h"
+#include "cco/arena.h"
+#include "cco/pool.h"
+#include "cco/scheduler.h"
 #include "cco/version.h"
+#include "cco/inline.h"
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,93 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file allocator.h
+ * 
+ * @brief Pluggable memory allocator of the library.
+ * 
+ * @details Avoid including this header directly.
+ */
+
+#ifndef CCO_ALLOCATOR_H_INCLUDED
+#define CCO_ALLOCATOR_H_INCLUDED
+
+#ifndef CCO_H_INCLUDED
+#  error "#include <cco.h> instead of this file directly"
+#endif
+
+/**
+ * @brief Set of hooks the library obtains its memory from.
+ * 
+ * @details The memory of the library comes in three kinds, each with its own pair of hooks:
+ *  - control blocks: pools, shared stack descriptors and the buffers the frames of a coroutine on a shared stack are
+ *    saved to while it is not running;
+ *  - contexts: the CPU context of a coroutine together with its control block, aligned as the CPU requires;
+ *  - stacks: the stack of a coroutine or of a shared stack, with no alignment required beyond the one of a pointer.
+ * 
+ * Every hook receives @ref user_data as its first argument, and the deallocation hooks also receive the size the memory
+ * was allocated with. An allocation hook returns NULL on failure, which the library reports as CCO_ERROR_NO_MEMORY.
+ * The memory is released with the allocator it was obtained from, whichever allocator is in use at that time: the
+ * allocator and its @ref user_data shall outlive every object created with them.
+ * 
+ * When no allocator is set, the library uses its default one: the static page region if STATIC_MALLOC_N_PAGES is not 0,
+ * then the C library, and the virtual memory of the system for guarded stacks. The default allocator also places the
+ * stack, the context and the control block of a coroutine in a single block; a custom one always allocates them
+ * separately, and it is responsible for guarding the stacks if it wants to, hence CCO_COROUTINE_FLAG_GUARDED_STACK has
+ * no effect on the coroutines it allocates.
+ */
+typedef struct cco_allocator {
+    void* (*allocate)(void* user_data, size_t size);                            /**< Allocates a control block */
+    void (*deallocate)(void* user_data, void* ptr, size_t size);                /**< Releases a control block */
+    void* (*allocate_context)(void* user_data, size_t size, size_t alignment);  /**< Allocates a context */
+    void (*deallocate_context)(void* user_data, void* ptr, size_t size);        /**< Releases a context */
+    void* (*allocate_stack)(void* user_data, size_t size);                      /**< Allocates a stack */
+    void (*deallocate_stack)(void* user_data, void* ptr, size_t size);          /**< Releases a stack */
+    void* user_data;                                                            /**< First argument of every hook */
+} cco_allocator;
+
+/**
+ * @brief Sets the allocator of every thread which does not have its own.
+ * 
+ * @warning The global allocator is not synchronized: set it before the other threads start using the library.
+ * 
+ * @param allocator A pointer to the allocator, NULL to restore the default one.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_set_allocator(const cco_allocator* allocator);
+
+/**
+ * @brief Sets the allocator of the calling thread, overriding the global one.
+ * 
+ * @param allocator A pointer to the allocator, NULL to use the global one again.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_set_thread_allocator(const cco_allocator* allocator);
+
+/**
+ * @brief Returns the allocator in use on the calling thread.
+ * 
+ * @return const cco_allocator* The allocator of the thread if set, otherwise the global one, NULL for the default one.
+ */
+CCO_API const cco_allocator* cco_get_allocator(void);
+
+#endif
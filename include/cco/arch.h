@@ -46,6 +46,9 @@
 #define CCO_ARCH_SPARC   12 /**< SPARC architecture */
 #define CCO_ARCH_SPARC64 13 /**< SPARC 64-bit architecture */
 
+/** Spelling of CCO_ARCH_ARM64 matching CMAKE_SYSTEM_PROCESSOR, as passed by the build system in CCO_TARGET_ARCH. */
+#define CCO_ARCH_aarch64 CCO_ARCH_ARM64
+
 /* If the architecture to compile for is not set from the build system, the library will try to detect it automatically. */
 #ifndef CCO_TARGET_ARCH
 /** Compiler-agnostic architecture definition */
@@ -16,4 +16,31 @@
  *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#error "currently not implemented"
\ No newline at end of file
+#ifndef CCO_ARCH_aarch64_H_INCLUDED
+#define CCO_ARCH_aarch64_H_INCLUDED
+
+/**
+ * @brief Settings for 64-bit ARM architectures.
+ * 
+ * @details The bits mirror the x86 settings with the same meaning: the full SIMD register file takes the position of
+ * the SSE registers, and the floating-point control registers (FPCR/FPSR) the one of the x87 control word and MXCSR.
+ * The callee-saved registers of the AAPCS64 (x19-x30, sp and the lower halves d8-d15 of v8-v15) are always exchanged.
+ * Only the registers enabled at compile time (see cmake/arch/aarch64.cmake) are actually exchanged, the other bits are
+ * ignored.
+ */
+typedef unsigned int cco_aarch64_settings;
+
+#define CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS ((cco_aarch64_settings)(1 << 2))
+/** Only FPCR and FPSR, the floating-point state the ABI requires to be preserved across calls besides d8-d15. */
+#define CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS ((cco_aarch64_settings)(1 << 8))
+
+typedef cco_aarch64_settings cco_architecture_specific_settings;
+
+/**
+ * @brief Upper bound of the memory taken by the CPU context of a coroutine with the given settings, including the
+ * padding it is aligned with, see CCO_COROUTINE_STORAGE_SIZE().
+ */
+#define CCO_CPU_CONTEXT_STORAGE_SIZE(settings)                                                                                   \
+  ((size_t)15 + 0xd0 + (((settings) & CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS) ? 32 * 16 : 0))
+
+#endif
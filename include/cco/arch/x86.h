@@ -31,7 +31,17 @@ typedef unsigned int cco_x86_settings;
 #define CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS ((cco_x86_settings)(1 << 3))
 #define CCO_SETTINGS_x86_EXCHANGE_DEBUG_REGISTERS   ((cco_x86_settings)(1 << 4))
 #define CCO_SETTINGS_x86_EXCHANGE_CONTROL_REGISTERS ((cco_x86_settings)(1 << 5))
+/** Only the x87 control word and MXCSR, the floating-point state the ABI requires to be preserved across calls. */
+#define CCO_SETTINGS_x86_EXCHANGE_FP_CONTROL_REGISTERS ((cco_x86_settings)(1 << 8))
 
 typedef cco_x86_settings cco_architecture_specific_settings;
 
+/**
+ * @brief Upper bound of the memory taken by the CPU context of a coroutine with the given settings, including the
+ * padding it is aligned with, see CCO_COROUTINE_STORAGE_SIZE().
+ */
+#define CCO_CPU_CONTEXT_STORAGE_SIZE(settings)                                                                                   \
+  ((size_t)15 + 0x30                                                                                                             \
+   + (((settings) & (CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS)) ? 512 : 0))
+
 #endif
@@ -16,4 +16,39 @@
  *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#error "currently not implemented"
\ No newline at end of file
+#ifndef CCO_ARCH_x86_64_H_INCLUDED
+#define CCO_ARCH_x86_64_H_INCLUDED
+
+/**
+ * @brief Settings for 64-bit x86 architectures.
+ * 
+ * @details The bits shared with the 32-bit x86 settings keep the same position. Only the registers enabled at
+ * compile time (see cmake/arch/x86_64.cmake) are actually exchanged, the other bits are ignored.
+ */
+typedef unsigned int cco_x86_64_settings;
+
+#define CCO_SETTINGS_x86_64_EXCHANGE_RFLAGS_REGISTER   ((cco_x86_64_settings)(1 << 0))
+#define CCO_SETTINGS_x86_64_EXCHANGE_FPU_MMX_REGISTERS ((cco_x86_64_settings)(1 << 1))
+#define CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS     ((cco_x86_64_settings)(1 << 2))
+#define CCO_SETTINGS_x86_64_EXCHANGE_SEGMENT_REGISTERS ((cco_x86_64_settings)(1 << 3))
+#define CCO_SETTINGS_x86_64_EXCHANGE_DEBUG_REGISTERS   ((cco_x86_64_settings)(1 << 4))
+#define CCO_SETTINGS_x86_64_EXCHANGE_CONTROL_REGISTERS ((cco_x86_64_settings)(1 << 5))
+#define CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS     ((cco_x86_64_settings)(1 << 6))
+#define CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS  ((cco_x86_64_settings)(1 << 7))
+/** Only the x87 control word and MXCSR, the floating-point state the ABI requires to be preserved across calls. */
+#define CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS ((cco_x86_64_settings)(1 << 8))
+
+typedef cco_x86_64_settings cco_architecture_specific_settings;
+
+/**
+ * @brief Upper bound of the memory taken by the CPU context of a coroutine with the given settings, including the
+ * padding it is aligned with, see CCO_COROUTINE_STORAGE_SIZE(). The XSAVE area is bounded by its standard format.
+ */
+#define CCO_CPU_CONTEXT_STORAGE_SIZE(settings)                                                                                   \
+  ((size_t)63 + 0x80                                                                                                             \
+   + (((settings) & CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS)                                                 ? 1664 + 1024 \
+      : ((settings) & CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS)                                                  ? 576 + 256   \
+      : ((settings) & (CCO_SETTINGS_x86_64_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS)) ? 512       \
+                                                                                                                     : 0))
+
+#endif
\ No newline at end of file
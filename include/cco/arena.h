@@ -0,0 +1,104 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file arena.h
+ * 
+ * @brief Huge-page backed arena for coroutine stacks and contexts.
+ * 
+ * @details Avoid including this header directly.
+ */
+
+#ifndef CCO_ARENA_H_INCLUDED
+#define CCO_ARENA_H_INCLUDED
+
+#ifndef CCO_H_INCLUDED
+#  error "#include <cco.h> instead of this file directly"
+#endif
+
+/**
+ * @brief Opaque struct carving fixed-size stacks and contexts out of a region of huge pages.
+ * 
+ * @details Switching among many coroutines touches a different stack each time, and with regular pages each one of them
+ * takes its own TLB entry. An arena maps its whole capacity at once with 2 MiB pages, explicit ones if the system has
+ * enough of them, transparent ones otherwise, so that many stacks share each entry. If neither is available, it falls
+ * back to regular pages and works the same.
+ * 
+ * Stacks are carved from the bottom of the region and contexts from its top, each of the size the arena was created
+ * for: the memory of destroyed coroutines is kept in one free list per kind and reused as it is. The arena is used
+ * through its allocator, see cco_arena_get_allocator(): control blocks other than the ones of the coroutines come from
+ * the default allocator.
+ * 
+ * @warning An arena is not thread-safe: like a cco_pool, it is meant to be owned by a single thread, typically as its
+ * allocator (see cco_set_thread_allocator()), and the coroutines it allocates shall be destroyed on that thread.
+ */
+typedef struct cco_arena cco_arena;
+
+/**
+ * @brief Creates an arena.
+ * 
+ * @param capacity The size of the region, rounded up to a multiple of 2 MiB.
+ * @param stack_size The size of each stack, rounded up to a multiple of the page size: larger ones cannot be allocated.
+ * @param settings The architecture-specific settings the contexts are sized for, NULL to fit any settings.
+ * @return cco_arena* A pointer to the newly created arena, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_arena* cco_arena_create(size_t capacity, size_t stack_size, const cco_architecture_specific_settings* settings);
+
+/**
+ * @brief Destroys an arena and unmaps its region.
+ * 
+ * @warning Every coroutine and shared stack allocated from the arena shall be destroyed before.
+ * 
+ * @param arena A pointer to the arena to destroy.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_arena_destroy(cco_arena* arena);
+
+/**
+ * @brief Returns the allocator allocating from the given arena, to be set with cco_set_allocator() or
+ * cco_set_thread_allocator().
+ * 
+ * @param arena A pointer to the arena.
+ * @return const cco_allocator* The allocator of the arena, valid as long as the arena is, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API const cco_allocator* cco_arena_get_allocator(cco_arena* arena);
+
+/**
+ * @brief Returns whether the region of the given arena is backed by huge pages.
+ * 
+ * @details True if the region is made of explicit huge pages, or if the system accepted to back it with transparent
+ * ones, which it still does at its own discretion.
+ * 
+ * @param arena A pointer to the arena.
+ * @return bool Whether the arena uses huge pages, false on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API bool cco_arena_uses_huge_pages(const cco_arena* arena);
+
+#endif
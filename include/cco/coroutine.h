@@ -63,7 +63,8 @@
  * cco_coroutine_destroy(). The coroutine can also be destroyed by itself, by calling cco_coroutine_destroy() from within
  * the coroutine itself.
  * 
- * @note Coroutines are not threads. They are not bound to a specific thread and they can be resumed on any thread.
+ * @note Coroutines are not threads. They are not bound to a specific thread and they can be resumed on any thread, once
+ * handed over with cco_coroutine_release() and cco_coroutine_acquire().
  * 
  * @warning The above note does not mean that a coroutine can be resumed concurrently on different threads. Doing so
  * will make the coroutine's execution context inconsistent, and it will result in undefined behavior. It is responsibility 
@@ -81,6 +82,27 @@ typedef struct cco_coroutine cco_coroutine;
  */
 typedef void (*cco_coroutine_callback)(void* argument);
 
+/**
+ * @brief Sets up the calling thread for the library, if not already done.
+ * 
+ * @details Each thread has its own main coroutine, the context of the thread outside of any coroutine, which the library
+ * sets up before main() for the thread that loads it, and for any other thread on its first creation or acquisition of
+ * a coroutine, or run of a scheduler. A thread which runs coroutines created elsewhere without acquiring them calls this
+ * function before starting or resuming the first one: the checked functions fail with CCO_ERROR_INVALID_CONTEXT on a
+ * thread which is not set up, and the fast ones do not check it.
+ * 
+ * @note Calling it again, from any context, has no effect.
+ * 
+ * @retval CCO_OK
+ */
+CCO_API void cco_thread_init(void);
+
+/**
+ * Smallest stack a coroutine is created with: room for the frame it starts from, aligned as the ABI requires, and for
+ * the few frames of a switch. Deeper calls from such a small stack go through cco_call_on_big_stack().
+ */
+#define CCO_MIN_STACK_SIZE 512
+
 /**
  * @brief Creates a new coroutine using compile-time architecture-specific settings.
  * 
@@ -93,15 +115,156 @@ typedef void (*cco_coroutine_callback)(void* argument);
  *  
  * @note The coroutine is created in a terminated state, in order for it to be started. Resuming it is undefined behavior.
  * 
- * @param stack_size The size of the stack to allocate for the coroutine.
+ * @param stack_size The size of the stack to allocate for the coroutine, at least CCO_MIN_STACK_SIZE.
  * @param settings A pointer to a cco_coroutine_settings struct containing the coroutine settings.
  * @return cco_coroutine* A pointer to the newly created coroutine, NULL on error.
  * 
  * @retval CCO_OK
  * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
  */
 CCO_API cco_coroutine* cco_coroutine_create(size_t stack_size, const cco_architecture_specific_settings* settings);
 
+/**
+ * @brief Flags selecting how the memory of a coroutine is obtained, see cco_coroutine_create_with_flags().
+ */
+typedef unsigned int cco_coroutine_flags;
+
+/** Use the flags the library was built with (GUARDED_STACKS and TRIM_STACKS in CMakeLists.txt). */
+#define CCO_COROUTINE_FLAGS_DEFAULT ((cco_coroutine_flags)(~0u))
+/** Allocate the coroutine from the allocator of the library, with no protection against stack overflows. */
+#define CCO_COROUTINE_FLAGS_NONE ((cco_coroutine_flags)0)
+/**
+ * Map the coroutine in its own virtual memory region, below which a page is left inaccessible: a stack overflow faults
+ * instead of corrupting the memory nearby. The pages of the stack only take physical memory once they are touched.
+ */
+#define CCO_COROUTINE_FLAG_GUARDED_STACK ((cco_coroutine_flags)(1u << 0))
+/**
+ * Trim the stack whenever the coroutine returns, see cco_coroutine_trim_stack(): the pages it touched are given back to
+ * the system instead of staying resident until the coroutine is destroyed. It costs a system call per return.
+ */
+#define CCO_COROUTINE_FLAG_TRIM_STACK ((cco_coroutine_flags)(1u << 1))
+
+/**
+ * @brief Creates a new coroutine, choosing how its memory is obtained.
+ * 
+ * @details Same as cco_coroutine_create(), with @p flags selecting how the memory of the coroutine is obtained instead
+ * of the default chosen at compile time. With CCO_COROUTINE_FLAG_GUARDED_STACK, the coroutine is mapped as a whole number of
+ * pages which are reserved without being committed, hence generous stacks can be given to a large number of coroutines
+ * while the physical memory in use stays proportional to the one they actually touch.
+ * 
+ * @note If an allocator is set with cco_set_allocator() or cco_set_thread_allocator(), the memory comes from it instead,
+ * and CCO_COROUTINE_FLAG_GUARDED_STACK has no effect.
+ * 
+ * @param stack_size The size of the stack to allocate for the coroutine, at least CCO_MIN_STACK_SIZE.
+ * @param settings A pointer to the architecture-specific settings, NULL for the default ones.
+ * @param flags A combination of CCO_COROUTINE_FLAG_* values, CCO_COROUTINE_FLAGS_DEFAULT for the compile-time default.
+ * @return cco_coroutine* A pointer to the newly created coroutine, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_coroutine* cco_coroutine_create_with_flags(
+    size_t stack_size, const cco_architecture_specific_settings* settings, cco_coroutine_flags flags
+);
+
+/**
+ * @brief Opaque struct of a stack shared by several coroutines.
+ * 
+ * @details The coroutines created on a shared stack all run on it, one at a time: when a coroutine is switched to while
+ * the stack holds the frames of another one, the used part of the stack of the latter (from its stack pointer to the
+ * top) is copied out to a buffer of its own, and the saved part of the former is copied back in. A suspended coroutine
+ * then only takes as much memory as its actual stack depth, at the cost of a copy whenever the coroutines of the same
+ * stack take turns.
+ * 
+ * @warning A coroutine on a shared stack can only be switched to from a context running on another stack: it cannot be
+ * started, resumed or transferred to by a coroutine on the same shared stack, which would be running on the very memory
+ * to overwrite, nor handed a caller on it by cco_transfer(). These calls fail with CCO_ERROR_INVALID_CONTEXT.
+ */
+typedef struct cco_shared_stack cco_shared_stack;
+
+/**
+ * @brief Creates a stack to be shared by several coroutines.
+ * 
+ * @details The stack is mapped like the one of a coroutine created with CCO_COROUTINE_FLAG_GUARDED_STACK: only the
+ * pages actually touched take physical memory, and an overflow faults.
+ * 
+ * @param stack_size The size of the stack, rounded up to a whole number of pages.
+ * @return cco_shared_stack* A pointer to the newly created stack, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_shared_stack* cco_shared_stack_create(size_t stack_size);
+
+/**
+ * @brief Destroys a shared stack.
+ * 
+ * @warning The coroutines created on the stack shall be destroyed first.
+ * 
+ * @param stack A pointer to the shared stack to destroy.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_shared_stack_destroy(cco_shared_stack* stack);
+
+/**
+ * @brief Creates a new coroutine running on a shared stack.
+ * 
+ * @details Same as cco_coroutine_create(), except that the coroutine does not own a stack: it runs on @p stack, see
+ * cco_shared_stack. Its stack size is the one of @p stack.
+ * 
+ * @note The buffer the frames of a suspended coroutine are copied to is allocated, or grown, before switching: if it
+ * cannot be, switching to a coroutine whose stack holds the frames of another one fails with CCO_ERROR_NO_MEMORY and
+ * nothing changes, e.g. in cco_resume(). A coroutine which cannot return this way at the end of its function retries.
+ * 
+ * @param stack A pointer to the shared stack to run on.
+ * @param settings A pointer to the architecture-specific settings, NULL for the default ones.
+ * @return cco_coroutine* A pointer to the newly created coroutine, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_coroutine* cco_coroutine_create_shared(cco_shared_stack* stack, const cco_architecture_specific_settings* settings);
+
+/** Upper bound of the memory taken by the control block of a coroutine, including the padding it is aligned with. */
+#define CCO_COROUTINE_CONTROL_BLOCK_STORAGE_SIZE 256
+
+/**
+ * @brief Size of a buffer large enough for cco_coroutine_create_in() to carve a coroutine with a stack of at least
+ * @p stack_size bytes out of it, whatever the alignment of the buffer.
+ * 
+ * @details A constant expression if its arguments are, so that the buffer can be sized statically. @p settings is the
+ * value of the architecture-specific settings, not a pointer to them: pass ~0u for a coroutine created with the default
+ * ones, which bounds the size for any settings.
+ */
+#define CCO_COROUTINE_STORAGE_SIZE(stack_size, settings)                                                                         \
+  ((size_t)(stack_size) + CCO_CPU_CONTEXT_STORAGE_SIZE(settings) + CCO_COROUTINE_CONTROL_BLOCK_STORAGE_SIZE)
+
+/**
+ * @brief Creates a new coroutine in a buffer provided by the caller.
+ * 
+ * @details Same as cco_coroutine_create(), except that no memory is allocated: the control block and the CPU context
+ * are placed at the end of @p buffer, and the stack takes all the rest of it. Size the buffer with
+ * CCO_COROUTINE_STORAGE_SIZE(). Destroying the coroutine does not release the buffer, which can be reused afterwards.
+ * A buffer which leaves less than CCO_MIN_STACK_SIZE bytes to the stack is rejected with CCO_ERROR_INVALID_ARGUMENT.
+ * 
+ * @warning The buffer shall outlive the coroutine, and it is not protected against stack overflows.
+ * 
+ * @param buffer The memory to create the coroutine in, with any alignment.
+ * @param size The size of @p buffer.
+ * @param settings A pointer to the architecture-specific settings, NULL for the default ones.
+ * @return cco_coroutine* A pointer to the newly created coroutine, located inside @p buffer, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_coroutine* cco_coroutine_create_in(void* buffer, size_t size, const cco_architecture_specific_settings* settings);
+
 /**
  * @brief Destroys the given coroutine.
  * 
@@ -112,11 +275,16 @@ CCO_API cco_coroutine* cco_coroutine_create(size_t stack_size, const cco_archite
  * 
  * @warning The coroutine must be in a suspended state. If it is not, the behavior is undefined.
  * 
+ * @note A coroutine in the ready queue of a scheduler is not destroyed, and CCO_ERROR_SCHEDULED is reported: it leaves
+ * the queue when the scheduler runs it, or when the scheduler is destroyed. Nor is a coroutine handed over with
+ * cco_coroutine_release() and not acquired yet, reporting CCO_ERROR_INVALID_CONTEXT.
+ * 
  * @param coroutine A pointer to the coroutine to destroy.
  * 
  * @retval CCO_OK
  * @retval CCO_ERROR_INVALID_ARGUMENT
  * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_SCHEDULED
  */
 CCO_API void cco_coroutine_destroy(cco_coroutine* coroutine);
 
@@ -140,6 +308,8 @@ CCO_API void cco_coroutine_destroy(cco_coroutine* coroutine);
  * 
  * @retval CCO_OK
  * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
  * @retval CCO_ERROR_SCHEDULED
  */
 CCO_API bool cco_coroutine_start(cco_coroutine* coroutine, cco_coroutine_callback function, void* argument);
@@ -170,6 +340,7 @@ CCO_API cco_coroutine* cco_this_coroutine(void);
  * 
  * @retval CCO_OK
  * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
  */
 CCO_API void cco_return(void* value);
 
@@ -184,6 +355,7 @@ CCO_API void cco_return(void* value);
  * 
  * @retval CCO_OK
  * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
  */
 CCO_API void cco_suspend(void);
 
@@ -198,6 +370,25 @@ CCO_API void cco_suspend(void);
  */
 CCO_API void cco_resume(cco_coroutine* coroutine);
 
+/**
+ * @brief Resumes the execution of the given coroutine, exchanging a value with it.
+ * 
+ * @details Like cco_resume(), but @p value is returned by the cco_yield_with() or cco_transfer() call @p coroutine
+ * is suspended in, and the value @p coroutine passes to cco_yield_with(), cco_yield() or cco_return() when it gives
+ * control back is returned. Values travel in a register through the context switch: a step of a bidirectional
+ * generator is a single switch, and neither the return value of the coroutine nor errno are written on success.
+ * 
+ * @param coroutine A pointer to the coroutine to resume.
+ * @param value The value to pass to @p coroutine.
+ * @return void* The value passed back by @p coroutine, NULL on error or if it gave control back without a value.
+ * 
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_NOT_SUSPENDED
+ */
+CCO_API void* cco_resume_with(cco_coroutine* coroutine, void* value);
+
 /**
  * @brief Yields the execution of the current coroutine.
  * 
@@ -211,6 +402,160 @@ CCO_API void cco_resume(cco_coroutine* coroutine);
  */
 CCO_API void cco_yield(void* value);
 
+/**
+ * @brief Yields the execution of the current coroutine, exchanging a value with the calling context.
+ * 
+ * @details Like cco_yield(), but @p value is returned by the cco_resume_with() call of the calling context instead of
+ * being stored in the coroutine, and the value the coroutine is resumed with is returned. Neither the return value
+ * of the coroutine nor errno are written on success.
+ * 
+ * @param value The value to pass to the calling context.
+ * @return void* The value passed to cco_resume_with() or cco_transfer() to resume the coroutine, NULL if it was
+ * resumed with cco_resume() or if called from the main context.
+ * 
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
+ */
+CCO_API void* cco_yield_with(void* value);
+
+/**
+ * @brief Transfers the execution from the current coroutine to the given one.
+ * 
+ * @details This function suspends the current coroutine and resumes @p next directly, without going through the
+ * calling context: a hand-off between two coroutines costs one context switch instead of two. The calling context of
+ * the current coroutine becomes the one of @p next, hence a cco_yield(), cco_suspend() or cco_return() in @p next
+ * returns control to whoever resumed the first coroutine of the chain.
+ * 
+ * If @p next is suspended in a cco_transfer() or cco_yield_with() call, that call returns @p value. Likewise, this
+ * function returns the value passed by the coroutine transferring control back to the current one, or NULL if it is
+ * resumed with cco_resume().
+ * 
+ * @note This function must be called from a coroutine, and @p next must be suspended.
+ * 
+ * @param next A pointer to the coroutine to transfer the execution to.
+ * @param value The value to pass to @p next.
+ * @return void* The value passed to the current coroutine when it is transferred to again, NULL otherwise.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_NOT_SUSPENDED
+ */
+CCO_API void* cco_transfer(cco_coroutine* next, void* value);
+
+/**
+ * @brief Like cco_coroutine_start(), but returns the error instead of writing errno.
+ * 
+ * @details The cco_*_fast() functions are the unchecked counterparts of the switching API, meant for the hot paths of
+ * schedulers and generators: they never touch errno, and they validate their arguments and their context only in
+ * debug builds of the library (i.e. built with CCO_DEBUG). In release builds, calling them with arguments or from a
+ * context their checked counterparts would reject is undefined behavior, and they return CCO_OK unless they switch to
+ * a coroutine on a shared stack whose frames cannot be saved, see cco_coroutine_create_shared().
+ * 
+ * The coroutines they suspend drop the value they are resumed with, e.g. by cco_resume_with() or cco_transfer(), and
+ * return CCO_OK instead. The value-exchanging functions have no fast counterpart, since cco_resume_with() and
+ * cco_yield_with() already leave errno untouched on success.
+ * 
+ * @param coroutine A pointer to the coroutine to start.
+ * @param function The function to execute in the coroutine.
+ * @param argument The argument to pass to the function.
+ * @return cco_error CCO_OK once the coroutine yielded or returned, an error otherwise (in debug builds only).
+ */
+CCO_API cco_error cco_coroutine_start_fast(cco_coroutine* coroutine, cco_coroutine_callback function, void* argument);
+
+/**
+ * @brief Like cco_this_coroutine(), but does not write errno.
+ * 
+ * @return cco_coroutine* Pointer to the currently running coroutine (NULL if not called from a coroutine).
+ */
+CCO_API cco_coroutine* cco_this_coroutine_fast(void);
+
+/**
+ * @brief Like cco_return(), but returns the error instead of writing errno, see cco_coroutine_start_fast().
+ * 
+ * @param value A pointer to the value to return.
+ * @return cco_error An error if called from the main context (in debug builds only), it does not return otherwise.
+ */
+CCO_API cco_error cco_return_fast(void* value);
+
+/**
+ * @brief Like cco_suspend(), but returns the error instead of writing errno, see cco_coroutine_start_fast().
+ * 
+ * @return cco_error CCO_OK once the coroutine is resumed, an error otherwise (in debug builds only).
+ */
+CCO_API cco_error cco_suspend_fast(void);
+
+/**
+ * @brief Like cco_resume(), but returns the error instead of writing errno, see cco_coroutine_start_fast().
+ * 
+ * @param coroutine A pointer to the coroutine to resume.
+ * @return cco_error CCO_OK once @p coroutine gave control back, an error otherwise (in debug builds only).
+ */
+CCO_API cco_error cco_resume_fast(cco_coroutine* coroutine);
+
+/**
+ * @brief Like cco_yield(), but returns the error instead of writing errno, see cco_coroutine_start_fast().
+ * 
+ * @param value The value to return to the caller.
+ * @return cco_error CCO_OK once the coroutine is resumed, an error otherwise (in debug builds only).
+ */
+CCO_API cco_error cco_yield_fast(void* value);
+
+/**
+ * @brief Like cco_transfer(), but returns the error instead of writing errno, see cco_coroutine_start_fast().
+ * 
+ * @details Unlike cco_transfer(), the value passed to the current coroutine when it is transferred to again is not
+ * returned.
+ * 
+ * @param next A pointer to the coroutine to transfer the execution to.
+ * @param value The value to pass to @p next.
+ * @return cco_error CCO_OK once the current coroutine is resumed, an error otherwise (in debug builds only).
+ */
+CCO_API cco_error cco_transfer_fast(cco_coroutine* next, void* value);
+
+/**
+ * @brief Function run by cco_call_on_big_stack().
+ */
+typedef void* (*cco_big_stack_function)(void* argument);
+
+/**
+ * @brief Calls a function on the big stack of the calling thread, and returns its result.
+ * 
+ * @details Each thread has a scratch stack of BIG_STACK_SIZE bytes (1 MiB by default, see CMakeLists.txt), mapped on
+ * the first call and committed only as far as it is touched. Running the stack-hungry calls of a coroutine on it, e.g.
+ * printf() or logging, lets the coroutine itself run on a stack of a few hundred bytes. The call costs two context
+ * switches with no optional register exchanged; nested calls run @p function directly.
+ * 
+ * @note The first call on a thread maps the big stack from the stack of the caller, which takes a few KiB: make it
+ * from the main context, or from a coroutine whose stack is large enough.
+ * 
+ * @warning @p function runs on behalf of the calling coroutine, but not on its stack: it shall not switch coroutines
+ * (the checked functions fail with CCO_ERROR_INVALID_CONTEXT if it tries, as do the fast ones in debug builds), nor
+ * throw an exception or longjmp() out of itself. It shall not expect changes to the optional registers exchanged by
+ * the calling coroutine (e.g. the floating-point control state) to outlive the call either.
+ * 
+ * @param function The function to call.
+ * @param argument The argument to pass to @p function.
+ * @return void* The value returned by @p function, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void* cco_call_on_big_stack(cco_big_stack_function function, void* argument);
+
+/**
+ * @brief Unmaps the big stack of the calling thread, see cco_call_on_big_stack().
+ * 
+ * @details To be called before a thread exits, if it used its big stack: it is not released otherwise. A later call
+ * to cco_call_on_big_stack() maps it again.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ */
+CCO_API void cco_release_big_stack(void);
+
 /**
  * @brief Alias for a callback to be called by the await mechanism.
  * 
@@ -313,9 +658,14 @@ CCO_API const cco_await_callback cco_await_ready;
  * By default, the default callbacks are set to NULL, which means that the await operation will always
  * be executed synchronously.
  * 
- * @note This function must be called from a coroutine. If it is called from the main context, the behavior is undefined.
+ * @note This function must be called from a coroutine: called from the main context, or from a function run by
+ * cco_call_on_big_stack(), it fails with CCO_ERROR_INVALID_CONTEXT.
  * 
  * @param arg The argument to pass to the callbacks.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
  */
 CCO_API void cco_await(void* arg);
 
@@ -325,11 +675,20 @@ CCO_API void cco_await(void* arg);
  * @details This function will execute the await mechanism as described in cco_await_callback.
  * Refer to the documentation of cco_await_callback for more information.
  * 
- * @note This function must be called from a coroutine. If it is called from the main context, the behavior is undefined.
+ * @note This function must be called from a coroutine: called from the main context, or from a function run by
+ * cco_call_on_big_stack(), it fails with CCO_ERROR_INVALID_CONTEXT.
+ * 
+ * @note If the caller of the coroutine runs on a shared stack whose frames cannot be saved, the await fails with
+ * CCO_ERROR_NO_MEMORY before @p on_suspend is called: the coroutine is never published as suspended unless it suspends.
  * 
  * @param ready The callback to call to check if the operation is ready.
  * @param on_suspend The callback to call if the operation is not ready.
  * @param arg The argument to pass to the callbacks.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
  */
 CCO_API void cco_await_with(cco_await_callback ready, cco_await_callback on_suspend, void* arg);
 
@@ -347,7 +706,8 @@ CCO_API const char* const cco_coroutine_state_strings[4];
  * @brief Returns the coroutine's execution state.
  * 
  * @details This function returns the coroutine's execution state. The execution state is a value that indicates
- * whether the coroutine is currently running, suspended, or has not been scheduled for execution yet.
+ * whether the coroutine is currently running, suspended, or has not been scheduled for execution yet. It can be called
+ * from any thread, including while another thread switches @p coroutine.
  * 
  * @note If called from the main execution context, it will always return CCO_COROUTINE_STATE_NONE.
  * 
@@ -356,6 +716,50 @@ CCO_API const char* const cco_coroutine_state_strings[4];
  */
 CCO_API cco_coroutine_state cco_coroutine_get_state(const cco_coroutine* coroutine);
 
+/**
+ * @brief Hands a coroutine over, for another thread to run it, see cco_coroutine_acquire().
+ * 
+ * @details Called by the thread that last ran @p coroutine, once it gave control back (e.g. after cco_resume()
+ * returned): its saved context and its stack, as well as whatever else the thread wrote before this call, become
+ * visible to the thread which acquires it. A release store is all it costs, and a coroutine which never changes thread
+ * needs neither call. Until it is acquired, no thread owns @p coroutine: cco_coroutine_start(), cco_resume(),
+ * cco_resume_with(), cco_transfer() and cco_coroutine_destroy() fail on it with CCO_ERROR_INVALID_CONTEXT, as do the
+ * fast functions in debug builds.
+ * 
+ * @note The state of a coroutine can be read from any thread at any time with cco_coroutine_get_state(), but it is
+ * written before the context is saved: seeing it suspended does not allow another thread to resume it.
+ * 
+ * @warning A coroutine whose frames are on a shared stack cannot change thread. A coroutine resumed on another thread
+ * shall not rely on what it learnt of its thread before: the compiler may keep the address of a thread-local variable,
+ * or the result of pthread_self(), from before the switch, which still refers to the previous thread.
+ * 
+ * @param coroutine A pointer to the suspended or unscheduled coroutine to hand over.
+ * @return bool True on success, false otherwise.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_NOT_SUSPENDED
+ */
+CCO_API bool cco_coroutine_release(cco_coroutine* coroutine);
+
+/**
+ * @brief Takes over a coroutine handed over with cco_coroutine_release(), to run it on the calling thread.
+ * 
+ * @details Only one of the threads acquiring the same release succeeds: it sees everything the releasing thread wrote
+ * before releasing @p coroutine, and it may then resume, start or destroy it. The calling thread is set up for the
+ * library if it was not already, see cco_thread_init(). The others fail with CCO_ERROR_NOT_RELEASED, as does acquiring a coroutine which has
+ * not been released.
+ * 
+ * @param coroutine A pointer to the coroutine to take over.
+ * @return bool True if the calling thread now owns @p coroutine, false otherwise.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_NOT_RELEASED
+ */
+CCO_API bool cco_coroutine_acquire(cco_coroutine* coroutine);
+
 /**
  * @brief Returns the stack size of the given coroutine.
  * 
@@ -377,6 +781,50 @@ CCO_API size_t cco_coroutine_get_stack_size(const cco_coroutine* coroutine);
  */
 CCO_API size_t cco_coroutine_get_stack_usage(const cco_coroutine* coroutine);
 
+/**
+ * @brief Returns the largest amount of stack space the given coroutine has ever used.
+ * 
+ * @details Only available if the library is built with STACK_PAINTING: the stack of each coroutine is then filled
+ * with a pattern when it is created, and this function scans it from its low end for the first word that was
+ * overwritten. The peak covers the whole lifetime of the coroutine, across restarts and pool reuses. For a coroutine on
+ * a shared stack, it is the peak of the shared stack, whichever coroutine reached it.
+ * 
+ * @note Painting touches the whole stack at creation, hence it commits all the pages of a guarded stack.
+ * 
+ * @warning Words written with the pattern value, or with zero (which is what trimmed pages read as, see
+ * cco_coroutine_trim_stack()), are not detected: the result is a lower bound.
+ * 
+ * @param coroutine A pointer to the coroutine.
+ * @return size_t The peak stack usage of the given coroutine, 0 on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_NOT_SUPPORTED
+ */
+CCO_API size_t cco_coroutine_get_stack_peak(const cco_coroutine* coroutine);
+
+/**
+ * @brief Gives the physical memory behind the unused part of the stack of the given coroutine back to the system.
+ * 
+ * @details The whole pages below the stack pointer of a suspended coroutine, or all the whole pages of the stack of an
+ * unscheduled one, are discarded (madvise(MADV_DONTNEED) or MEM_RESET) while staying mapped: they take physical memory
+ * again only once touched. This is meant for coroutines which once went deep and then stay suspended for long, e.g.
+ * waiting on an idle connection. Coroutines created with CCO_COROUTINE_FLAG_TRIM_STACK are trimmed on return already.
+ * 
+ * A coroutine on a shared stack is only trimmed while it holds the stack, see cco_shared_stack.
+ * 
+ * @note With STACK_PAINTING, the peak reached so far is recorded before the pages lose their pattern, and
+ * cco_coroutine_get_stack_peak() still reports it.
+ * 
+ * @param coroutine A pointer to the coroutine, which shall not be running.
+ * @return size_t The number of bytes discarded, 0 on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ */
+CCO_API size_t cco_coroutine_trim_stack(cco_coroutine* coroutine);
+
 /**
  * @brief Retrieved the value returned by the coroutine.
  * 
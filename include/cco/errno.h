@@ -41,6 +41,8 @@ typedef enum {
     CCO_ERROR_UNSCHEDULED,      /**< Coroutine is not scheduled */
     CCO_ERROR_NOT_SUSPENDED,    /**< Coroutine is not suspended */
     CCO_ERROR_NOT_RUNNING,      /**< Coroutine is not running */
+    CCO_ERROR_NOT_SUPPORTED,    /**< Feature disabled at compile time */
+    CCO_ERROR_NOT_RELEASED,     /**< Coroutine not released by the thread it ran on, or acquired by another one */
 } cco_error;
 
 /** Error code pointer of the current thread */
@@ -0,0 +1,102 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file inline.h
+ * 
+ * @brief Inline queries on the current coroutine and on the state of a coroutine, for the hot loops of schedulers.
+ * 
+ * @details Available if the library is built with INLINE_API, the default everywhere but on Windows: the library then
+ * exports its thread-local pointer to the current coroutine with the initial-exec TLS model, and keeps the members of
+ * cco_coroutine these functions read at fixed offsets. Each of them compiles to one or two loads, with neither a call
+ * nor a lookup of the thread-local storage of the library. Like the cco_*_fast() functions, they neither validate their
+ * arguments nor write errno.
+ * 
+ * @note With the initial-exec model, the thread-local variables of the shared library live in the static TLS block of
+ * the program: loading it with dlopen() works only as long as the few bytes they take are available there.
+ * 
+ * Avoid including this header directly.
+ */
+
+#ifndef CCO_INLINE_H_INCLUDED
+#define CCO_INLINE_H_INCLUDED
+
+#ifndef CCO_H_INCLUDED
+#  error "#include <cco.h> instead of this file directly"
+#endif
+
+#if CCO_INLINE_API
+
+/** \cond */
+#  if defined(__GNUC__) || defined(__clang__)
+#    define CCO_INLINE           static inline __attribute__((always_inline))
+#    define CCO_INLINE_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#  else
+#    error "INLINE_API requires GCC or Clang"
+#  endif
+
+/* Offsets of the members of cco_coroutine read below, which the library checks its definition against. */
+#  define CCO_COROUTINE_RETURN_VALUE_OFFSET sizeof(void*)
+#  define CCO_COROUTINE_STATE_OFFSET        (2 * sizeof(void*))
+
+/* The main coroutine and the current coroutine of the calling thread, see src/coroutine.c. */
+CCO_API __thread cco_coroutine  cco_main_coroutine CCO_INLINE_TLS_MODEL;
+CCO_API __thread cco_coroutine* cco_current_coroutine CCO_INLINE_TLS_MODEL;
+/** \endcond */
+
+/**
+ * @brief Inline version of cco_this_coroutine(), which does not write errno.
+ * 
+ * @return cco_coroutine* Pointer to the currently running coroutine (NULL if not called from a coroutine).
+ */
+CCO_INLINE cco_coroutine*
+cco_this_coroutine_inline(void)
+{
+    cco_coroutine* current = cco_current_coroutine;
+    return current != &cco_main_coroutine ? current : NULL;
+}
+
+/**
+ * @brief Inline version of cco_coroutine_get_state(), which neither validates @p coroutine nor writes errno.
+ * 
+ * @param coroutine A pointer to the coroutine to query, not NULL.
+ * @return cco_coroutine_state The execution state of @p coroutine.
+ */
+CCO_INLINE cco_coroutine_state
+cco_coroutine_get_state_inline(const cco_coroutine* coroutine)
+{
+    return (cco_coroutine_state)__atomic_load_n(
+        (const cco_coroutine_state*)((const char*)coroutine + CCO_COROUTINE_STATE_OFFSET), __ATOMIC_ACQUIRE
+    );
+}
+
+/**
+ * @brief Inline version of cco_coroutine_get_return_value(), which neither validates @p coroutine nor writes errno.
+ * 
+ * @param coroutine A pointer to the coroutine to query, not NULL.
+ * @return void* The value @p coroutine last yielded or returned.
+ */
+CCO_INLINE void*
+cco_coroutine_get_return_value_inline(const cco_coroutine* coroutine)
+{
+    return *(void* const*)((const char*)coroutine + CCO_COROUTINE_RETURN_VALUE_OFFSET);
+}
+
+#endif
+
+#endif
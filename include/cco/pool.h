@@ -0,0 +1,137 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file pool.h
+ * 
+ * @brief Recycling of coroutines by stack size class.
+ * 
+ * @details Avoid including this header directly.
+ */
+
+#ifndef CCO_POOL_H_INCLUDED
+#define CCO_POOL_H_INCLUDED
+
+#ifndef CCO_H_INCLUDED
+#  error "#include <cco.h> instead of this file directly"
+#endif
+
+/** Number of stack size classes of a pool. */
+#define CCO_POOL_SIZE_CLASSES 4
+
+/** Stack size of the coroutines of class @p size_class: 4 KiB, 16 KiB, 64 KiB and 256 KiB. */
+#define CCO_POOL_CLASS_STACK_SIZE(size_class) ((size_t)4096 << (2 * (size_class)))
+
+/**
+ * @brief Opaque struct caching released coroutines for reuse.
+ * 
+ * @details A pool keeps one free list per stack size class. Acquiring a coroutine pops it from the list of the smallest
+ * class its stack fits in, and releasing it pushes it back, both in constant time: the coroutine is created or destroyed
+ * only when the list is empty or full. All the coroutines of a pool share the architecture-specific settings and the
+ * flags the pool was created with, and their memory comes from the allocator in use on the thread creating the pool.
+ * 
+ * The free lists are not thread-local: a pool is an object the caller creates and owns, so that it can be destroyed
+ * with the coroutines it caches, and several pools with different settings can coexist on a thread. Per-thread free
+ * lists are one pool per thread: acquiring and releasing then take no synchronization at all.
+ * 
+ * @warning A pool is not thread-safe: it is meant to be owned by a single thread, typically one pool per thread, which
+ * is the only one acquiring from it and releasing to it. The coroutines themselves can still be run anywhere.
+ */
+typedef struct cco_pool cco_pool;
+
+/**
+ * @brief Creates an empty pool.
+ * 
+ * @param settings The architecture-specific settings of the coroutines of the pool, NULL for the default ones.
+ * @param flags The flags the coroutines of the pool are created with, see cco_coroutine_create_with_flags().
+ * @param max_cached The number of released coroutines kept for each size class, the others are destroyed.
+ * @return cco_pool* A pointer to the newly created pool, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_pool* cco_pool_create(const cco_architecture_specific_settings* settings, cco_coroutine_flags flags, size_t max_cached);
+
+/**
+ * @brief Destroys a pool together with the coroutines it caches.
+ * 
+ * @note The coroutines acquired from the pool are not affected, and shall be destroyed with cco_coroutine_destroy().
+ * 
+ * @param pool A pointer to the pool to destroy.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_pool_destroy(cco_pool* pool);
+
+/**
+ * @brief Acquires an unscheduled coroutine with a stack of at least @p stack_size bytes.
+ * 
+ * @details The stack size is rounded up to the one of its size class, and a cached coroutine of that class is reused
+ * if there is one. Coroutines with a stack larger than the largest class are created with the exact size and never
+ * cached.
+ * 
+ * @param pool A pointer to the pool to acquire from.
+ * @param stack_size The minimum size of the stack of the coroutine.
+ * @return cco_coroutine* A pointer to the coroutine, ready to be started, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API cco_coroutine* cco_pool_acquire(cco_pool* pool, size_t stack_size);
+
+/**
+ * @brief Releases a coroutine to a pool, instead of destroying it.
+ * 
+ * @details The coroutine is cached if its stack size is the one of a size class, if it was created with the settings and
+ * the flags of the pool, and if the list of its class is not full; otherwise it is destroyed. Any coroutine can be
+ * released, not only the ones acquired from @p pool: a cached coroutine is reset as if it had just been created, with
+ * no return value, no stack peak (its stack is painted again with STACK_PAINTING) and no trace of a scheduler, and a
+ * suspended one is unscheduled without resuming it.
+ * 
+ * @warning The same warnings of cco_coroutine_destroy() apply, and a coroutine in the ready queue of a scheduler is
+ * likewise neither cached nor destroyed, reporting CCO_ERROR_SCHEDULED, nor is a coroutine released to another thread
+ * and not acquired yet, reporting CCO_ERROR_INVALID_CONTEXT.
+ * 
+ * @param pool A pointer to the pool to release to.
+ * @param coroutine A pointer to the coroutine to release.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ * @retval CCO_ERROR_SCHEDULED
+ */
+CCO_API void cco_pool_release(cco_pool* pool, cco_coroutine* coroutine);
+
+/**
+ * @brief Destroys the coroutines cached by a pool beyond the first @p keep of each size class.
+ * 
+ * @details This is the slow path giving the memory of the cached coroutines back, e.g. after a peak of load.
+ * 
+ * @param pool A pointer to the pool to trim.
+ * @param keep The number of coroutines to keep for each size class.
+ * @return size_t The number of coroutines destroyed.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API size_t cco_pool_trim(cco_pool* pool, size_t keep);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file scheduler.h
+ * 
+ * @brief Single-threaded run queue of coroutines.
+ * 
+ * @details Avoid including this header directly.
+ */
+
+#ifndef CCO_SCHEDULER_H_INCLUDED
+#define CCO_SCHEDULER_H_INCLUDED
+
+#ifndef CCO_H_INCLUDED
+#  error "#include <cco.h> instead of this file directly"
+#endif
+
+/**
+ * @brief Opaque struct running the coroutines which are ready, in FIFO order.
+ * 
+ * @details The ready queue is intrusive: it is linked through the coroutines themselves, so that queueing one never
+ * allocates and costs a couple of stores. cco_scheduler_run() resumes the coroutine at the head of the queue until it
+ * gives control back, and goes on with the next one until the queue is empty. A coroutine leaves the queue when it is
+ * resumed, and gets back into it through cco_scheduler_yield() or cco_scheduler_wake(): one suspended in any other way,
+ * e.g. awaiting with cco_scheduler_park as its on_suspend callback, is parked until an event wakes it up.
+ * 
+ * The scheduler does not own its coroutines: it neither creates nor destroys them, and one which returns is simply not
+ * resumed again. A coroutine is in the queue at most once: waking it again before it runs has no effect. When its turn
+ * comes, a coroutine is only started if it was spawned and has not been started since, and only resumed if it is
+ * suspended: one started, resumed or returned by other means in the meantime is dropped from the queue.
+ * 
+ * @warning A scheduler is not thread-safe: it is meant to be owned by a single thread, typically one scheduler per
+ * thread, which is the only one spawning, waking and running its coroutines. A coroutine shall be in the queue of at
+ * most one scheduler at a time: cco_coroutine_destroy() and cco_pool_release() fail with CCO_ERROR_SCHEDULED while
+ * it is queued.
+ */
+typedef struct cco_scheduler cco_scheduler;
+
+/**
+ * @brief Creates a scheduler with an empty ready queue.
+ * 
+ * @return cco_scheduler* A pointer to the newly created scheduler, NULL on error.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_NO_MEMORY
+ */
+CCO_API cco_scheduler* cco_scheduler_create(void);
+
+/**
+ * @brief Destroys a scheduler.
+ * 
+ * @note The coroutines still in its queue leave it without running, and shall be destroyed with cco_coroutine_destroy().
+ * 
+ * @param scheduler A pointer to the scheduler to destroy.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ */
+CCO_API void cco_scheduler_destroy(cco_scheduler* scheduler);
+
+/**
+ * @brief Queues an unscheduled coroutine, to be started by the scheduler with @p function and @p argument.
+ * 
+ * @details Unlike cco_coroutine_start(), it returns right away: the coroutine starts when the scheduler gets to it. It
+ * fails with CCO_ERROR_SCHEDULED if @p coroutine is already queued, e.g. spawned twice.
+ * 
+ * @param scheduler A pointer to the scheduler to run the coroutine.
+ * @param coroutine A pointer to the unscheduled coroutine to spawn.
+ * @param function The function to execute in the coroutine.
+ * @param argument The argument to pass to @p function.
+ * @return bool True on success, false otherwise.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_SCHEDULED
+ */
+CCO_API bool cco_spawn(cco_scheduler* scheduler, cco_coroutine* coroutine, cco_coroutine_callback function, void* argument);
+
+/**
+ * @brief Queues a parked coroutine again, e.g. from the handler of the event it waits for.
+ * 
+ * @details Nothing is done, and CCO_OK is reported, if @p coroutine is already queued by @p scheduler: waking it several
+ * times before it runs, or after it yielded, resumes it once. If it is queued by another scheduler, nothing is done
+ * either and CCO_ERROR_SCHEDULED is reported: it is run by that one.
+ * 
+ * @param scheduler A pointer to the scheduler to run the coroutine.
+ * @param coroutine A pointer to the suspended coroutine to wake up.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_NOT_SUSPENDED
+ * @retval CCO_ERROR_SCHEDULED
+ */
+CCO_API void cco_scheduler_wake(cco_scheduler* scheduler, cco_coroutine* coroutine);
+
+/**
+ * @brief Queues the current coroutine at the tail of the ready queue, and gives control back to the scheduler.
+ * 
+ * @details The other ready coroutines run before it is resumed, in turn.
+ * 
+ * @param scheduler A pointer to the scheduler running the current coroutine.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ */
+CCO_API void cco_scheduler_yield(cco_scheduler* scheduler);
+
+/**
+ * @brief Runs the ready coroutines until the queue is empty.
+ * 
+ * @details Each coroutine runs until it yields, suspends or returns, and the coroutines it spawns or wakes run in the
+ * same call. The thread is set up first if needed, see cco_thread_init(). A coroutine which cannot be switched to from
+ * the calling context, as cco_coroutine_start() or cco_resume() would refuse, is dropped from the queue without running:
+ * e.g. one sharing its stack with the coroutine calling this function. The queue is still run to the end, and the last
+ * such error is reported.
+ * 
+ * @param scheduler A pointer to the scheduler to run.
+ * @return size_t The number of times a coroutine was started or resumed.
+ * 
+ * @retval CCO_OK
+ * @retval CCO_ERROR_INVALID_ARGUMENT
+ * @retval CCO_ERROR_INVALID_CONTEXT
+ */
+CCO_API size_t cco_scheduler_run(cco_scheduler* scheduler);
+
+/**
+ * @brief on_suspend callback parking the awaiting coroutine, see cco_await_with().
+ * 
+ * @details The coroutine is suspended without being queued: it is resumed once cco_scheduler_wake() queues it again.
+ * For instance, with the event loop of cco_await_with():
+ * 
+ * @code{.c}
+ * cco_await_with(NULL, cco_scheduler_park, NULL); // resumed after cco_scheduler_wake(scheduler, coroutine)
+ * @endcode
+ */
+CCO_API const cco_await_callback cco_scheduler_park;
+
+#endif
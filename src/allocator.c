@@ -0,0 +1,67 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/allocator.c
+ *
+ * @brief Selection of the allocator set with cco_set_allocator() and cco_set_thread_allocator().
+ */
+
+#include "errno.h"
+#include "memory.h"
+
+CCO_PRIVATE const cco_allocator*              cco_global_allocator;
+CCO_PRIVATE thread_local const cco_allocator* cco_thread_allocator;
+
+/**
+ * @brief Whether every hook of @p allocator is set.
+ */
+CCO_PRIVATE always_inline bool
+cco_allocator_is_valid(const cco_allocator* allocator)
+{
+    return allocator->allocate && allocator->deallocate && allocator->allocate_context && allocator->deallocate_context
+           && allocator->allocate_stack && allocator->deallocate_stack;
+}
+
+CCO_API_INTERNAL void
+cco_set_allocator(const cco_allocator* allocator)
+{
+    if(allocator && !cco_allocator_is_valid(allocator)) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    cco_global_allocator  = allocator;
+    *cco_errno_location() = CCO_OK;
+}
+
+CCO_API_INTERNAL void
+cco_set_thread_allocator(const cco_allocator* allocator)
+{
+    if(allocator && !cco_allocator_is_valid(allocator)) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    cco_thread_allocator  = allocator;
+    *cco_errno_location() = CCO_OK;
+}
+
+CCO_API_INTERNAL const cco_allocator*
+cco_get_allocator(void)
+{
+    return cco_thread_allocator ? cco_thread_allocator : cco_global_allocator;
+}
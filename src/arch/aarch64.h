@@ -0,0 +1,321 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CCO_SRC_ARCH_aarch64_H_INCLUDED
+#define CCO_SRC_ARCH_aarch64_H_INCLUDED
+
+#if !defined(CCO_COROUTINE_IMPLEMENTATION) && !defined(__ASSEMBLER__)
+#  error "This file was designed to be included from coroutine.c or aarch64.S directly"
+#endif
+
+/* The following definitions are shared with aarch64.S. */
+
+#define CCO_aarch64_BARE_CSWITCH                                                                                                 \
+  (!(CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE || CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE))
+
+/** Offsets of the optional fields of cco_cpu_context, see the struct documentation. */
+#define CCO_aarch64_CONTEXT_FP_CONTROL_OFFSET       0xb0
+#define CCO_aarch64_CONTEXT_OUTER_FP_CONTROL_OFFSET 0xc0
+#define CCO_aarch64_CONTEXT_SIMD_OFFSET             0xd0
+
+/** Plain-number copies of the settings bits, usable from aarch64.S. */
+#define CCO_aarch64_SIMD_SETTINGS       0x04
+#define CCO_aarch64_FP_CONTROL_SETTINGS 0x100
+
+/** Alignment of the buffer holding a cco_cpu_context, as required by the q-register pair loads and stores. */
+#define CCO_CPU_CONTEXT_ALIGNMENT 16
+
+#ifndef __ASSEMBLER__
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Basic AArch64 registers struct.
+ *
+ * @details Only the registers the AAPCS64 defines as callee-saved are stored: x19-x28, the frame pointer, the link
+ * register, the stack pointer and the lower 64 bits of v8-v15. The other general purpose and SIMD registers are
+ * already considered clobbered by the caller of cco_cswitch(). Like on x86, the struct is the head of a buffer whose size
+ * is computed at runtime from the settings of the coroutine (see cco_get_cpu_context_size()).
+ */
+struct cco_cpu_context {
+    void*    x19;   /* 0x00 */
+    void*    x20;   /* 0x08 */
+    void*    x21;   /* 0x10 */
+    void*    x22;   /* 0x18 */
+    void*    x23;   /* 0x20 */
+    void*    x24;   /* 0x28 */
+    void*    x25;   /* 0x30 */
+    void*    x26;   /* 0x38 */
+    void*    x27;   /* 0x40 */
+    void*    x28;   /* 0x48 */
+    void*    fp;    /* 0x50, x29 */
+    void*    lr;    /* 0x58, x30 */
+    void*    sp;    /* 0x60 */
+    void*    pc;    /* 0x68 */
+    uint64_t d[8];  /* 0x70, d8-d15 */
+
+    /*  The following fields are only present if the corresponding registers are enabled at compile time.
+
+        Floating-point control and status registers: rounding mode, flush-to-zero and exception flags.
+
+    uint64_t fpcr;                                              // 0xb0
+    uint64_t fpsr;                                              // 0xb8
+
+        FPCR of the outer context, recorded when the coroutine is switched to and loaded back when it is suspended
+        (see cco_cswitch_bare()).
+
+    uint64_t outer_fpcr;                                        // 0xc0
+    uint8_t  padding[8];                                        // 0xc8
+
+        The whole SIMD register file, including the upper halves of v8-v15.
+
+    uint8_t  q[32][16];                                         // 0xd0
+    */
+};
+
+#pragma pack(pop)
+
+_Static_assert(
+    CCO_aarch64_SIMD_SETTINGS == CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS,
+    "The value of CCO_aarch64_SIMD_SETTINGS differs from the value of CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS"
+);
+_Static_assert(
+    CCO_aarch64_FP_CONTROL_SETTINGS == CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS,
+    "The value of CCO_aarch64_FP_CONTROL_SETTINGS differs from the value of CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS"
+);
+_Static_assert(sizeof(cco_cpu_context) == CCO_aarch64_CONTEXT_FP_CONTROL_OFFSET, "The optional fields follow d8-d15");
+_Static_assert(offsetof(cco_coroutine, context) == 0, "cco_cswitch() expects the context at offset 0 of cco_coroutine");
+
+/**
+ * @brief Thread-local context of the main coroutine.
+ *
+ * @details See the x86 counterpart for the meaning of the main context. It is sized for the worst case allowed by
+ * the compile-time settings.
+ */
+CCO_PRIVATE thread_local _Alignas(CCO_CPU_CONTEXT_ALIGNMENT) uint8_t cco_main_context
+    [
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+        CCO_aarch64_CONTEXT_SIMD_OFFSET + 32 * 16
+#elif CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+        CCO_aarch64_CONTEXT_OUTER_FP_CONTROL_OFFSET + sizeof(uint64_t)
+#else
+        sizeof(cco_cpu_context)
+#endif
+] = {0};
+
+_Static_assert(
+    CCO_CPU_CONTEXT_STORAGE_SIZE(~0u) >= sizeof(cco_main_context) + CCO_CPU_CONTEXT_ALIGNMENT - 1,
+    "CCO_CPU_CONTEXT_STORAGE_SIZE() does not bound the size of the context"
+);
+
+#define CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS() &cco_default_aarch64_settings_instance;
+
+CCO_PRIVATE cco_aarch64_settings cco_default_aarch64_settings_instance = 0
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE && CCO_aarch64_SIMD_REGISTERS_DEFAULT_EXCHANGE
+                                                                         | CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS
+#endif
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE && CCO_aarch64_FP_CONTROL_REGISTERS_DEFAULT_EXCHANGE
+                                                                         | CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS
+#endif
+    ;
+
+/** @brief Detects the features of the CPU the context switch depends on: AdvSIMD is mandatory on AArch64. */
+CCO_PRIVATE always_inline void
+cco_init_cpu_features(void)
+{}
+
+CCO_PRIVATE always_inline size_t
+cco_get_cpu_context_size(const cco_architecture_specific_settings* settings)
+{
+    // clang-format off
+#if CCO_aarch64_BARE_CSWITCH
+    (void) settings;
+    return sizeof(struct cco_cpu_context);
+#else
+    return
+#   if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    (*settings & CCO_aarch64_SIMD_SETTINGS) ? CCO_aarch64_CONTEXT_SIMD_OFFSET + 32 * 16 :
+#   endif
+#   if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    (*settings & CCO_aarch64_FP_CONTROL_SETTINGS) ? CCO_aarch64_CONTEXT_OUTER_FP_CONTROL_OFFSET + sizeof(uint64_t) :
+#   endif
+    sizeof(struct cco_cpu_context);
+#endif
+    // clang-format on
+}
+
+/**
+ * @brief Initializes a freshly allocated CPU context.
+ *
+ * @details The FPCR of the outer context starts as the current one. It only matters for the main coroutine, which is
+ * never entered through cco_fp_entry_point() and runs on the thread setting it up: the other coroutines record it again
+ * each time they are started. No other field outlives a restart of the coroutine on AArch64.
+ *
+ * @param coroutine The coroutine whose context shall be initialized, including the main one
+ */
+CCO_PRIVATE always_inline void
+cco_init_cpu_context(cco_coroutine* coroutine)
+{
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    if(coroutine->settings & CCO_aarch64_FP_CONTROL_SETTINGS) {
+        uint64_t fpcr;
+        __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+        *(uint64_t*)((uint8_t*)coroutine->context + CCO_aarch64_CONTEXT_OUTER_FP_CONTROL_OFFSET) = fpcr;
+    }
+#else
+    (void)coroutine;
+#endif
+}
+
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+/**
+ * @brief First entry of a coroutine owning FPCR/FPSR, implemented in aarch64.S.
+ *
+ * @details Branched to in place of cco_coroutine_entry_point(), whose address it finds in x19: it records the FPCR of
+ * the outer context in the context of the coroutine (x8), as the resume label of its routine does on the following
+ * switches.
+ */
+hidden void cco_fp_entry_point(void);
+#endif
+
+/**
+ * @brief Prepares the CPU context for the first call to cco_cswitch().
+ *
+ * @details The return address is in the link register on AArch64, nothing is pushed: the stack pointer is just aligned
+ * to 16 bytes, as required by the ABI at any time, and the frame pointer and the link register are cleared to end the
+ * frame chain. The coroutine pointer is passed in x0 by cco_cswitch() itself, which always loads the next coroutine in
+ * the first argument register. A coroutine owning FPCR/FPSR starts from cco_fp_entry_point() instead.
+ *
+ * @param coroutine The coroutine whose context shall be prepared
+ */
+CCO_PRIVATE always_inline void
+cco_prepare_coroutine(cco_coroutine* coroutine)
+{
+    cco_cpu_context* ctx = coroutine->context;
+    ctx->sp              = (void*)(((uintptr_t)(coroutine->stack + coroutine->stack_size)) & ~(uintptr_t)15);
+    ctx->fp              = NULL;
+    ctx->lr              = NULL;
+    ctx->pc              = (void*)(uintptr_t)cco_coroutine_entry_point;
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    if(coroutine->settings & CCO_aarch64_FP_CONTROL_SETTINGS) {
+        ctx->x19 = ctx->pc;
+        ctx->pc  = (void*)(uintptr_t)cco_fp_entry_point;
+    }
+#endif
+}
+
+/**
+ * @brief Stores the current CPU context in @p prev and loads the one stored in @p next.
+ *
+ * @details The callee-saved registers, the stack pointer and the resume address are always exchanged. The optional
+ * registers are saved by the coroutine being suspended before the stack is switched; the resume address stored in
+ * @p prev points right after the branch to @p next, where the same coroutine restores them once it is switched back to.
+ *
+ * The ABI requires FPCR to be preserved across calls, and the caller of cco_cswitch() may be bare: a coroutine owning
+ * it records the one it finds when it is switched to, before restoring its own, and loads it back once it has saved its
+ * own. Its FPCR never leaks into another context, which finds the one that was live when the coroutine was switched to.
+ *
+ * There is one routine for each combination of optional registers enabled at compile time, each one exchanging its
+ * registers unconditionally: a coroutine always suspends through the routine selected from its settings at creation
+ * time (see cco_select_cswitch()), and the routine of @p next is not involved.
+ *
+ * When branching to @p next, x0 is loaded with @p next: this is the argument of cco_coroutine_entry_point() for a
+ * coroutine which is started for the first time, and it is ignored otherwise. @p value stays in x2, which no routine
+ * touches otherwise, and it is returned by the call to cco_cswitch() @p next was suspended in.
+ *
+ * @note Implemented in aarch64.S, so that the optimizer can neither reorder nor inline them.
+ *
+ * @param prev the coroutine to suspend, whose CPU context is stored (x0)
+ * @param next the coroutine to resume, whose CPU context is loaded (x1)
+ * @param value the value to hand over to @p next (x2)
+ * @return void* the value handed over by the coroutine resuming @p prev (x0)
+ */
+hidden cswitch_abi void* cco_cswitch_bare(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_simd(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE && CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fpcontrol_simd(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+
+/**
+ * @brief Context switch routines, indexed by the optional registers they exchange: bit 0 for FPCR/FPSR, bit 1 for the
+ * SIMD registers.
+ */
+CCO_PRIVATE const cco_cswitch_routine cco_cswitch_routines[4] = {
+    [0] = cco_cswitch_bare,
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    [1] = cco_cswitch_fpcontrol,
+#endif
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    [2] = cco_cswitch_simd,
+#endif
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE && CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    [3] = cco_cswitch_fpcontrol_simd,
+#endif
+};
+
+/**
+ * @brief Selects the context switch routine matching @p settings.
+ *
+ * @details Only the bits of the registers enabled at compile time are considered, so that the index always refers to
+ * a routine which has been assembled.
+ *
+ * @param settings the settings of the coroutine
+ * @return cco_cswitch_routine the routine the coroutine shall be suspended with
+ */
+CCO_PRIVATE always_inline cco_cswitch_routine
+cco_select_cswitch(const cco_architecture_specific_settings* settings)
+{
+    unsigned int index = 0;
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    index |= (*settings & CCO_aarch64_FP_CONTROL_SETTINGS) ? 1 : 0;
+#endif
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    index |= (*settings & CCO_aarch64_SIMD_SETTINGS) ? 2 : 0;
+#endif
+    (void)settings;
+    return cco_cswitch_routines[index];
+}
+
+CCO_PRIVATE always_inline uint8_t*
+cco_current_stack_pointer(void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    uint8_t* sp;
+    __asm__ volatile("mov %0, sp" : "=r"(sp));
+    return sp;
+#elif defined(_MSC_VER)
+    return (uint8_t*)_AddressOfReturnAddress();
+#else
+#  error Unsupported compiler
+#endif
+}
+
+CCO_PRIVATE always_inline uint8_t*
+cco_get_stack_pointer(const cco_coroutine* coroutine)
+{
+    return (uint8_t*)coroutine->context->sp;
+}
+
+#endif /* __ASSEMBLER__ */
+
+#endif
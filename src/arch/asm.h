@@ -0,0 +1,74 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/arch/asm.h
+ *
+ * @brief Object-format-agnostic macros for the assembly sources in src/arch.
+ *
+ * @details Every routine is emitted as a global symbol with hidden visibility: it can be called from the other
+ * translation units of the library, but it is neither exported from the shared library nor interposable.
+ */
+
+#ifndef CCO_SRC_ARCH_ASM_H_INCLUDED
+#define CCO_SRC_ARCH_ASM_H_INCLUDED
+
+#ifndef __ASSEMBLER__
+#  error "This file was designed to be included from the assembly sources in src/arch"
+#endif
+
+#if defined(__APPLE__)
+#  define CCO_ASM_SYMBOL(name) _##name
+#  define CCO_ASM_HIDDEN(name) .private_extern CCO_ASM_SYMBOL(name)
+#  define CCO_ASM_TYPE(name)
+#  define CCO_ASM_SIZE(name)
+#elif defined(__ELF__)
+#  define CCO_ASM_SYMBOL(name) name
+#  define CCO_ASM_HIDDEN(name) .hidden name
+#  define CCO_ASM_TYPE(name)   .type name, %function
+#  define CCO_ASM_SIZE(name)   .size name, . - name
+#else /* PE/COFF: there is no visibility, the symbol is simply not listed in the export table */
+#  define CCO_ASM_SYMBOL(name) name
+#  define CCO_ASM_HIDDEN(name)
+#  define CCO_ASM_TYPE(name)
+#  define CCO_ASM_SIZE(name)
+#endif
+
+/** Opens the definition of the routine @p name, together with its call frame information. */
+#define CCO_ASM_FUNCTION_BEGIN(name)                                                                                             \
+  .text;                                                                                                                         \
+  .p2align 4;                                                                                                                    \
+  .globl CCO_ASM_SYMBOL(name);                                                                                                   \
+  CCO_ASM_HIDDEN(name);                                                                                                          \
+  CCO_ASM_TYPE(name);                                                                                                            \
+  CCO_ASM_SYMBOL(name):;                                                                                                         \
+  .cfi_startproc
+
+/** Closes the definition of the routine @p name. */
+#define CCO_ASM_FUNCTION_END(name)                                                                                               \
+  .cfi_endproc;                                                                                                                  \
+  CCO_ASM_SIZE(name)
+
+/** Marks the stack of the object as non-executable, which the linker would otherwise assume for assembly sources. */
+#if defined(__ELF__)
+#  define CCO_ASM_NO_EXECUTABLE_STACK .section .note.GNU-stack, "", %progbits
+#else
+#  define CCO_ASM_NO_EXECUTABLE_STACK
+#endif
+
+#endif
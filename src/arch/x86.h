@@ -19,34 +19,49 @@
 #ifndef CCO_SRC_ARCH_x86_H_INCLUDED
 #define CCO_SRC_ARCH_x86_H_INCLUDED
 
-#ifndef CCO_COROUTINE_IMPLEMENTATION
-#  error "This file was designed to be included from coroutine.c directly"
+#if !defined(CCO_COROUTINE_IMPLEMENTATION) && !defined(__ASSEMBLER__)
+#  error "This file was designed to be included from coroutine.c or x86.S directly"
 #endif
 
-/** Compiler-agnostic macro to define a fastcall calling convention. */
-#if defined(__GNUC__) || defined(__clang__)
-#  define fastcall __attribute__((fastcall))
-#elif defined(_MSC_VER)
-#  define fastcall __fastcall
-#elif defined(__ICC) || defined(__INTEL_COMPILER)
-#  define fastcall __fastcall
-#else
-#  error Unsupported compiler
+#if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE || CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE
+#  error "Debug and control registers are only accessible at CPL 0 and cannot be exchanged on x86"
 #endif
 
-/** Compiler-agnostic cpuid wrapper, defined as a macro */
-#if defined(__GNUC__) || defined(__clang__)
-#  include <cpuid.h>
-#  define cco_cpuid(idx, eax, ebx, ecx, edx) __cpuid(idx, eax, ebx, ecx, edx);
-#elif defined(_MSC_VER)
-#  include <intrin.h>
-#  define cco_cpuid(idx, eax, ebx, ecx, edx) __cpuid((int[4]){eax, ebx, ecx, edx}, idx);
-#elif defined(__ICC) || defined(__INTEL_COMPILER)
-#  include <immintrin.h>
-#  define cco_cpuid(idx, eax, ebx, ecx, edx) _cpuid_count(idx, 0, eax, ebx, ecx, edx);
-#else
-#  error Compiler not supported
-#endif
+/* The following definitions are shared with x86.S. */
+
+#define CCO_x86_BARE_CSWITCH                                                                                                     \
+  (!(CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE || CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE                                        \
+     || CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE || CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE                                       \
+     || CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE))
+
+/** FPU/MMX and SSE registers are exchanged together with FXSAVE/FXRSTOR, available on every CPU since the Pentium II. */
+#define CCO_x86_ENABLE_FPU_EXCHANGE (CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE || CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE)
+
+/** Whether some coroutine may own the floating-point control words, and keep the ones of the outer context aside. */
+#define CCO_x86_OUTER_FP_CONTROL (CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE || CCO_x86_ENABLE_FPU_EXCHANGE)
+
+/** Offsets of the optional fields of cco_cpu_context, see the struct documentation. */
+#define CCO_x86_CONTEXT_EFLAGS_OFFSET           0x18
+#define CCO_x86_CONTEXT_SEGMENT_OFFSET          0x1c
+#define CCO_x86_CONTEXT_FP_CONTROL_OFFSET       0x24
+#define CCO_x86_CONTEXT_OUTER_FP_CONTROL_OFFSET 0x2a
+#define CCO_x86_CONTEXT_FPU_OFFSET              0x30
+
+/** Plain-number copies of the settings bits, usable from x86.S. */
+#define CCO_x86_EFLAGS_SETTINGS     0x01
+#define CCO_x86_FPU_SETTINGS        0x06 /* FPU/MMX | SSE */
+#define CCO_x86_SEGMENT_SETTINGS    0x08
+#define CCO_x86_FP_CONTROL_SETTINGS 0x100
+
+/** How the floating-point state is exchanged, as assembled in x86.S: control words only, or the whole FXSAVE area. */
+#define CCO_x86_FPU_NONE    0
+#define CCO_x86_FPU_CONTROL 1
+#define CCO_x86_FPU_FXSAVE  2
+
+/** Alignment of the buffer holding a cco_cpu_context, as required by FXSAVE. */
+#define CCO_CPU_CONTEXT_ALIGNMENT 16
+
+#ifndef __ASSEMBLER__
 
 #pragma pack(push, 1)
 
@@ -64,75 +79,68 @@ struct cco_cpu_context {
     void*   ecx;
     void*   edx;
     */
-    void* ebx;
-    void* esi;
-    void* edi;
-    void* ebp;
-    void* esp;
-    void* eip;
+    void* ebx; /* 0x00 */
+    void* esi; /* 0x04 */
+    void* edi; /* 0x08 */
+    void* ebp; /* 0x0c */
+    void* esp; /* 0x10 */
+    void* eip; /* 0x14 */
 
     /*  All of the following registers are to be enabled via register-specific compile-time settings.
         This and the following comments expose the registers as documentation only; the size of the struct to be allocated
         will be calculated at runtime according to the x86-specific runtime settings of the chosen coroutine, and
         only using the registers enabled by the compile-time settings. The cco_cswitch function (responsible of
         storing and restoring the context) will also use the runtime settings, to determine which registers to save and restore.
-    */
+        Every field has a fixed offset, so that the assembly does not need to compute it from the settings.
 
-    /* Eflags register.
-    uint32_t eflags;
-    */
+    uint32_t eflags;                                            // 0x18
 
-    // union fpu_mmx_sse {
-    // struct no_sse {
-    /* FPU/MMX registers. MMX is fully contained in FPU.
-            uint16_t fpu_status;                                // 16-bit
-            uint16_t fpu_control;                               // 16-bit
-            uint16_t fpu_tag_word;                              // 16-bit
-            struct { uint16_t high, uint32_t low; } fpu_ip;     // 48-bit
-            struct { uint16_t high, uint32_t low; } fpu_dp;     // 48-bit                  
-            uint16_t fpu_opcode;                                // 11-bit
-            struct { uint16_t low; uint32_t high; } st[8];      // 8 registers of 80-bit each
-            */
-
-    /* SSE registers.
-            struct { uint64_t high; uint64_t low; } xmm[8];     // 8 registers of 128-bit each
-            uint32_t mxcsr;                                     // 32-bit
-            */
-    //  } no_sse; // end struct no_sse
-    /* If all of FPU, MMX and SSE registers are enabled, the fxsave area is used to store the context.
-            uint8_t fxsave[512];
-            */
-    // }; // end union fpu_mmx_sse
-
-    /* Segment registers.
-    uint16_t cs;
-    uint16_t ds;
-    uint16_t es;
-    uint16_t fs;
-    uint16_t gs;
-    uint16_t ss;
-    */
+        Segment registers. %cs and %ss cannot be loaded with a mov, and never differ between coroutines anyway.
 
-    /* Debug registers.
-    uint32_t dr0;
-    uint32_t dr1;
-    uint32_t dr2;
-    uint32_t dr3;
-    uint32_t dr6;
-    uint32_t dr7;
-    */
+    uint16_t ds;                                                // 0x1c
+    uint16_t es;                                                // 0x1e
+    uint16_t fs;                                                // 0x20
+    uint16_t gs;                                                // 0x22
+
+        Floating-point control state, the only part of it the ABI requires to be preserved across calls: a cheaper
+        alternative to FXSAVE for coroutines changing the rounding mode or the exception masks only. MXCSR requires
+        a CPU with SSE, like FXSAVE does.
+
+    uint32_t mxcsr;                                             // 0x24
+    uint16_t fpucw;                                             // 0x28
 
-    /* Control registers.
-    uint32_t cr0;
-    uint32_t cr2;
-    uint32_t cr3;
-    uint32_t cr4;
-    uint32_t cr8;
+        Floating-point control words of the outer context, recorded when the coroutine is switched to and loaded back
+        when it is suspended, by the coroutines owning the control words or the FXSAVE area (see cco_cswitch_bare()).
+
+    uint16_t outer_fpucw;                                       // 0x2a
+    uint32_t outer_mxcsr;                                       // 0x2c
+
+        FPU/MMX and SSE registers, stored with FXSAVE in a 16-byte aligned area.
+
+    uint8_t  fxsave[512];                                       // 0x30
     */
 };
 
 #pragma pack(pop)
 
+_Static_assert(
+    CCO_x86_EFLAGS_SETTINGS == CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER,
+    "The value of CCO_x86_EFLAGS_SETTINGS differs from the value of CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER"
+);
+_Static_assert(
+    CCO_x86_FPU_SETTINGS == (CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS),
+    "The value of CCO_x86_FPU_SETTINGS differs from the FPU/MMX and SSE settings"
+);
+_Static_assert(
+    CCO_x86_SEGMENT_SETTINGS == CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS,
+    "The value of CCO_x86_SEGMENT_SETTINGS differs from the value of CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS"
+);
+_Static_assert(
+    CCO_x86_FP_CONTROL_SETTINGS == CCO_SETTINGS_x86_EXCHANGE_FP_CONTROL_REGISTERS,
+    "The value of CCO_x86_FP_CONTROL_SETTINGS differs from the value of CCO_SETTINGS_x86_EXCHANGE_FP_CONTROL_REGISTERS"
+);
+_Static_assert(offsetof(cco_coroutine, context) == 0, "cco_cswitch() expects the context at offset 0 of cco_coroutine");
+
 /**
  * @brief Thread-local context of the main coroutine.
  * 
@@ -145,32 +153,26 @@ struct cco_cpu_context {
  * @note Each thread in a program may start and/or resume a coroutine, and each of these contexts
  * shall be saved. This is why the main context is thread-local.
  */
-CCO_PRIVATE thread_local _Alignas(16) uint8_t cco_main_context
-    [sizeof(cco_cpu_context)
-#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-     + sizeof(uint32_t)
-#endif
-#if CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE && CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
-#  if !CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-     + sizeof(uint32_t)
-#  endif
-     + sizeof(uint8_t[512])
-#elif CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE
-     + sizeof(uint8_t[(16 + 16 + 16 + 48 + 48 + 16 + 8 * 80) / 8])
-#elif CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
-     + sizeof(uint8_t[(32 + 8 * 128) / 8])
-#endif
-#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
-     + sizeof(uint16_t[6])
-#endif
-#if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE
-     + sizeof(uint32_t[6])
-#endif
-#if CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE
-     + sizeof(uint32_t[5])
+CCO_PRIVATE thread_local _Alignas(CCO_CPU_CONTEXT_ALIGNMENT) uint8_t cco_main_context
+    [
+#if CCO_x86_ENABLE_FPU_EXCHANGE
+        CCO_x86_CONTEXT_FPU_OFFSET + 512
+#elif CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+        CCO_x86_CONTEXT_OUTER_FP_CONTROL_OFFSET + sizeof(uint16_t) + sizeof(uint32_t)
+#elif CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+        CCO_x86_CONTEXT_SEGMENT_OFFSET + sizeof(uint16_t[4])
+#elif CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+        CCO_x86_CONTEXT_EFLAGS_OFFSET + sizeof(uint32_t)
+#else
+        sizeof(cco_cpu_context)
 #endif
 ] = {0};
 
+_Static_assert(
+    CCO_CPU_CONTEXT_STORAGE_SIZE(~0u) >= sizeof(cco_main_context) + CCO_CPU_CONTEXT_ALIGNMENT - 1,
+    "CCO_CPU_CONTEXT_STORAGE_SIZE() does not bound the size of the context"
+);
+
 #define CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS() &cco_default_x86_settings_instance;
 
 CCO_PRIVATE cco_x86_settings cco_default_x86_settings_instance = 0
@@ -186,100 +188,82 @@ CCO_PRIVATE cco_x86_settings cco_default_x86_settings_instance = 0
 #if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE && CCO_x86_SEGMENT_REGISTERS_DEFAULT_EXCHANGE
                                                                  | CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS
 #endif
-#if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE && CCO_x86_DEBUG_REGISTERS_DEFAULT_EXCHANGE
-                                                                 | CCO_SETTINGS_x86_EXCHANGE_DEBUG_REGISTERS
-#endif
-#if CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE && CCO_x86_CONTROL_REGISTERS_DEFAULT_EXCHANGE
-                                                                 | CCO_SETTINGS_x86_EXCHANGE_CONTROL_REGISTERS
+#if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE && CCO_x86_FP_CONTROL_REGISTERS_DEFAULT_EXCHANGE
+                                                                 | CCO_SETTINGS_x86_EXCHANGE_FP_CONTROL_REGISTERS
 #endif
     ;
 
-#define CCO_x86_BARE_CSWITCH                                                                                                     \
-  (!(CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE || CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE                                        \
-     || CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE || CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE                                       \
-     || CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE || CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE))
-
-#define CCO_x86_ELIGIBLE_FOR_FXSR (CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE && CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE)
+/** @brief Detects the features of the CPU the context switch depends on: FXSAVE is assumed on x86, nothing to do. */
+CCO_PRIVATE always_inline void
+cco_init_cpu_features(void)
+{}
 
 CCO_PRIVATE always_inline size_t
 cco_get_cpu_context_size(const cco_architecture_specific_settings* settings)
 {
     // clang-format off
 #if CCO_x86_BARE_CSWITCH
-    // It was not needed to wrap this in a conditional block, but is not a problem either.
     (void) settings;
-#endif
-    return sizeof(struct cco_cpu_context)
-#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-#   if CCO_x86_ELIGIBLE_FOR_FXSR
-    // this branch accounts for the fact that FXSR requires 16-byte alignment; with eflags we have 32 bytes and it's good
-    // If we don't have EFLAGS but we have FXSR, we pad 4 bytes anyway
-    + ((*settings & CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER || 
-        *settings & (CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS)) ? sizeof(uint32_t) : 0)
-#   else
-    + ((*settings & CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER) ? sizeof(uint32_t) : 0)
+    return sizeof(struct cco_cpu_context);
+#else
+    return
+#   if CCO_x86_ENABLE_FPU_EXCHANGE
+    (*settings & CCO_x86_FPU_SETTINGS) ? CCO_x86_CONTEXT_FPU_OFFSET + 512 :
 #   endif
-#endif
-#if CCO_x86_ELIGIBLE_FOR_FXSR
-#   if !CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-    // this is to pad 4 bytes and reach 32 bytes alignment for FXSR if we did not enter in the previous #if branch
-    + ( // first branch is for FPU/MMX and SSE combined (fxsr), second for FPU/MMX only, and third for SSE only
-    ((*settings & (CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS)) ? sizeof(uint32_t) + sizeof(uint8_t[512]) :
-    ((*settings & CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS) ? sizeof(uint8_t[(16+16+16+48+48+16+8*80)/8]) :
-    ((*settings & CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS) ? sizeof(uint8_t[(32+8*128)/8]) : 0
-    ))))
-#   else
-    + ( // first branch is for FPU/MMX and SSE combined (fxsr), second for FPU/MMX only, and third for SSE only
-    ((*settings & (CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS)) ? sizeof(uint8_t[512]) :
-    ((*settings & CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS) ? sizeof(uint8_t[(16+16+16+48+48+16+8*80)/8]) :
-    ((*settings & CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS) ? sizeof(uint8_t[(32+8*128)/8]) : 0
-    ))))
+#   if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    (*settings & CCO_x86_FP_CONTROL_SETTINGS) ? CCO_x86_CONTEXT_OUTER_FP_CONTROL_OFFSET + sizeof(uint16_t) + sizeof(uint32_t) :
 #   endif
-#elif CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE
-    + ((*settings & CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS) ? sizeof(uint8_t[(16+16+16+48+48+16+8*80)/8]) : 0)
-#elif CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
-    + ((*settings & CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS) ? sizeof(uint8_t[(32+8*128)/8]) : 0)
-#endif
-#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
-    + (*setting & CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS) ? sizeof(uint16_t[6]) : 0
-#endif
-#if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE
-    + (*setting & CCO_SETTINGS_x86_EXCHANGE_DEBUG_REGISTERS) ? sizeof(uint32_t[6]) : 0
-#endif
-#if CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE
-    + (*setting & CCO_SETTINGS_x86_EXCHANGE_CONTROL_REGISTERS) ? sizeof(uint32_t[5]) : 0
+#   if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+    (*settings & CCO_x86_SEGMENT_SETTINGS) ? CCO_x86_CONTEXT_SEGMENT_OFFSET + sizeof(uint16_t[4]) :
+#   endif
+#   if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+    (*settings & CCO_x86_EFLAGS_SETTINGS) ? CCO_x86_CONTEXT_EFLAGS_OFFSET + sizeof(uint32_t) :
+#   endif
+    sizeof(struct cco_cpu_context);
 #endif
-    ;
     // clang-format on
 }
 
-#if CCO_x86_ELIGIBLE_FOR_FXSR
-
-/** @brief Whether the CPU supports fxsave. Initialized in cco_init() and cached. */
-CCO_PRIVATE volatile bool cco_x86_has_fxsr;
-
 /**
- * @brief Whether the CPU supports fxsave. Initialized in cco_init() and cached.
- * 
- * @note This function creates 4 local variables, so it should be called only once at startup.
- * Specialized assembly is used in cco_cswitch() to avoid the overhead of this function.
- * 
- * @return bool whether the CPU supports fxsave or not 
+ * @brief Initializes a freshly allocated CPU context.
+ *
+ * @details The control words of the outer context start as the current ones. They only matter for the main coroutine,
+ * which is never entered through cco_fp_entry_point() and runs on the thread setting it up: the other coroutines record
+ * them again each time they are started. No other field outlives a restart of the coroutine on x86.
+ *
+ * @param coroutine The coroutine whose context shall be initialized, including the main one
  */
-CCO_PRIVATE always_inline bool
-cco_x86_retrieve_has_fxsr()
+CCO_PRIVATE always_inline void
+cco_init_cpu_context(cco_coroutine* coroutine)
 {
-    uint32_t eax, ebx, ecx, edx;
-    cco_cpuid(1, eax, ebx, ecx, edx);
-    return (edx & (1 << 24)) != 0;
+#if CCO_x86_OUTER_FP_CONTROL
+    if(coroutine->settings & (CCO_x86_FP_CONTROL_SETTINGS | CCO_x86_FPU_SETTINGS)) {
+        uint8_t* ctx = (uint8_t*)coroutine->context;
+        __asm__ volatile("fnstcw %0" : "=m"(*(uint16_t*)(ctx + CCO_x86_CONTEXT_OUTER_FP_CONTROL_OFFSET + 0)));
+        __asm__ volatile("stmxcsr %0" : "=m"(*(uint32_t*)(ctx + CCO_x86_CONTEXT_OUTER_FP_CONTROL_OFFSET + 2)));
+    }
+#else
+    (void)coroutine;
+#endif
 }
+
+#if CCO_x86_OUTER_FP_CONTROL
+/**
+ * @brief First entry of a coroutine owning floating-point control words, implemented in x86.S.
+ *
+ * @details Jumped to in place of cco_coroutine_entry_point(), whose address it finds in %ebx: it records the control
+ * words of the outer context in the context of the coroutine (%eax), as the resume label of its routine does on the
+ * following switches.
+ */
+hidden void cco_fp_entry_point(void);
 #endif
 
 /**
  * @brief Prepares the CPU context for the first call to cco_cswitch().
  * 
  * @details This function contains x86-specific code to prepare the CPU context for the first call to cco_cswitch().
- * In particular, it sets the instruction pointer to the entry point of the coroutine 
+ * In particular, it sets the instruction pointer to the entry point of the coroutine, or to cco_fp_entry_point() for a
+ * coroutine owning floating-point control words.
  * 
  * @param ctx The context to prepare
  */
@@ -292,301 +276,164 @@ cco_prepare_coroutine(cco_coroutine* coroutine)
         1.  The stack grows downwards (push -> decrement, pop -> increment)
         2.  The argument in cco_coroutine_entry_point is passed on the stack.
         3.  We cannot store the variable in stack + size, or it will overflow.
+        4.  The ABI requires the argument area to be 16-byte aligned at the call site.
     */
-    ctx->esp          = coroutine->stack + coroutine->stack_size - sizeof(ctx->eip);
-    *(void**)ctx->esp = coroutine;
+    uintptr_t argument = ((uintptr_t)(coroutine->stack + coroutine->stack_size) - sizeof(void*)) & ~(uintptr_t)15;
+    *(void**)argument  = coroutine;
 
     /* 
         We have to emulate a call to cco_coroutine_entry_point; to do that, the caller would
-        push the return address on the stack, and then jump to the entry point.
-        Remind that the stack is increased first and read after when popping
-        and stored first and decreased after when pushing. So to account for storage of the return address,
-        we have to decrement the stack pointer by 2 * sizeof(ctx->esp) (the size of the return address).
-        The assembly will do the following to retrieve the argument from the stack:
-            movl 0x8(%esp), %eax
+        push the return address on the stack, and then jump to the entry point. cco_cswitch() jumps to the
+        entry point with %esp pointing to a null return address, right below the argument.
     */
-    ctx->esp = (char*)ctx->esp - 2 * sizeof(ctx->esp);
-    ctx->ebp = (char*)ctx->esp + sizeof(ctx->esp);
+    ctx->esp          = (void*)(argument - sizeof(void*));
+    *(void**)ctx->esp = NULL;
+    ctx->ebp          = NULL;
+#if CCO_x86_OUTER_FP_CONTROL
+    if(coroutine->settings & (CCO_x86_FP_CONTROL_SETTINGS | CCO_x86_FPU_SETTINGS)) {
+        ctx->ebx = ctx->eip;
+        ctx->eip = (void*)(uintptr_t)cco_fp_entry_point;
+    }
+#endif
 }
 
 /**
  * @brief Stores the current CPU context in @p prev and loads the one stored in @p next.
  * 
- * @details This function will implement con a compiler-agnostic way the context switch function for the x86 architecture.
- * It will store the current CPU context in @p prev and load the one stored in @p next.
- * According to the configuration specified at compile time, it will exchange the general purpose registers,
- * the stack pointer and instruction pointer, the FPU registers, the floating-point control registers,
- * the x87/MMX/XMM registers (if available), and the flags register. In particular:
- * - the stack pointer and instruction pointer are always exchanged, because they correspond to the context by itself;
- * - the general purpose registers are exchanged if @ref CCO_x86_EXCHANGE_GENERAL_PURPOSE_REGISTERS is set to 1;
- * - the FPU registers, the floating-point control registers, and the x87/MMX/XMM registers are exchanged only
- * - the flags register is exchanged if @ref CCO_x86_EXCHANGE_FLAGS_REGISTER is set to 1;
- *   if @ref CCO_x86_EXCHANGE_FPU_AND_MMX_REGISTERS is set to 1;
- *   - in particular, if CCO_x86_USE_HAS_FXSR is set, the cpuid check for fxsave/fxrstor is performed once at startup,
- *     and later usages of such instructions are checked against the cached value; these instructions are not used if
- *     the CPU does not support them (pretty rare nowadays).
+ * @details The callee-saved general purpose registers, the stack pointer and the resume address are always exchanged.
+ * The optional registers (flags, segment, FPU/MMX/SSE registers or just the floating-point control words, as enabled
+ * at compile time) are saved by the
+ * coroutine being suspended, and restored by the same coroutine once it is resumed: the resume address stored in
+ * @p prev points right after the jump to @p next.
+ *
+ * The ABI requires the control bits of MXCSR and of the x87 control word to be preserved across calls, and the caller
+ * of cco_cswitch() may be bare: a coroutine owning them (with the control words or the FXSAVE area) records the ones it
+ * finds when it is switched to, before restoring its own, and loads them back once it has saved its own. Its control
+ * words never leak into another context, which finds the ones that were live when the coroutine was switched to.
+ *
+ * There is one routine for each combination of optional registers enabled at compile time, each one exchanging its
+ * registers unconditionally: a coroutine always suspends through the routine selected from its settings at creation
+ * time (see cco_select_cswitch()), and the routine of @p next is not involved.
+ *
+ * @note Implemented in x86.S, so that the optimizer can neither reorder nor inline them.
  * 
- * @param prev the current CPU context to store (and suspend)
- * @param next the CPU context to load (and resume)
+ * @param prev the current CPU context to store (and suspend) (%ecx)
+ * @param next the CPU context to load (and resume) (%edx)
+ * @param value the value to hand over to @p next, carried through the switch in %ecx (on the stack)
+ * @return void* the value handed over by the coroutine resuming @p prev (%eax)
  */
-CCO_PRIVATE no_inline fastcall naked void
-cco_cswitch(unused cco_coroutine* restrict prev, unused cco_coroutine* restrict next)
-{
-    // We mark the arguments as unused to avoid warnings, but we actually use them in the assembly code.
-    // ecx contains the address of prev, edx contains the address of next.
-
-    // In the first implementation of this function I was using prev/next to actually access their fields, but
-    // 1. I obtained suboptimal code (twice the number of instructions for each register stored)
-    // 2. The code could not work when using -O3 (most likely because the function was not naked, though).
-    // Eventually I wrote the function in C for if control statements, mixed with pure assembly code by hand.
-#if defined(__GNUC__) || defined(__clang__)
-
-#  if !CCO_x86_BARE_CSWITCH
-    __asm__ volatile("pushl 4(%ecx)");
-#  endif
-    __asm__ volatile("movl (%ecx), %ecx");     /* %ecx = prev->context;*/
-    __asm__ volatile("movl %ebx, 0x00(%ecx)"); /* prev->context.ebx = %ebx; */
-#  if !CCO_x86_BARE_CSWITCH
-    __asm__ volatile("popl %ebx");
-#  endif
-    __asm__ volatile("movl %esi, 0x04(%ecx)");                /* prev->context.esi = %esi; */
-    __asm__ volatile("movl %edi, 0x08(%ecx)");                /* prev->context.edi = %edi; */
-    __asm__ volatile("movl %ebp, 0x0c(%ecx)");                /* prev->context.ebp = %ebp; */
-    __asm__ volatile("movl %esp, 0x10(%ecx)");                /* prev->context.esp = %esp; */
-    __asm__ volatile("popl %edi \n\t movl %edi, 0x14(%ecx)"); /* prev->context.eip = %eip; */
-#  if !CCO_x86_BARE_CSWITCH
-    __asm__ volatile("addl $28, %ecx"); /* %ecx = (&prev->context.eip + 1); */
-#    define __asm__STR(X)  __asm__STR2(X)
-#    define __asm__STR2(X) #X
-#  endif
+hidden cswitch_abi void* cco_cswitch_bare(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_segment(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags_segment(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE && CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_segment_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE && CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags_segment_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fpu(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags_fpu(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE && CCO_x86_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_segment_fpu(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE && CCO_x86_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_eflags_segment_fpu(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
 
+/**
+ * @brief Context switch routines, indexed by how the floating-point state is exchanged (CCO_x86_FPU_*) and by the
+ * other optional registers they exchange: bit 0 for EFLAGS, bit 1 for the segment registers.
+ */
+CCO_PRIVATE const cco_cswitch_routine cco_cswitch_routines[3][4] = {
+    [CCO_x86_FPU_NONE] = {
+        [0] = cco_cswitch_bare,
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+        [1] = cco_cswitch_eflags,
+#endif
+#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+        [2] = cco_cswitch_segment,
+#endif
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+        [3] = cco_cswitch_eflags_segment,
+#endif
+    },
+#if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    [CCO_x86_FPU_CONTROL] = {
+        [0] = cco_cswitch_fpcontrol,
 #  if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-#    define EXCHANGE_EFLAGS_REGISTER (1 << 0)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER == EXCHANGE_EFLAGS_REGISTER,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER differs from the value of EXCHANGE_EFLAGS_REGISTER"
-    );
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_EFLAGS_REGISTER) ", %ebx"); /* if (settings & EXCHANGE_EFLAGS_REGISTER) */
-    __asm__ volatile("jz .Lno_store_flags_registers");                        /* then */
-    __asm__ volatile("pushf");                                                /* push %eflags; */
-    __asm__ volatile("popl %esi");                                            /* %ebx = %eflags; */
-    __asm__ volatile("movl %esi, 0x00(%ecx)");                                /* prev->context.eflags = %eflags; */
-    __asm__ volatile("addl $4, %ecx");                                        /* %ecx = (&prev->context.eflags + 1); */
-    __asm__ volatile(".Lno_store_flags_registers:");                          /* else */
-#  endif
-
-#  if CCO_x86_ELIGIBLE_FOR_FXSR
-#    define EXCHANGE_FPU_MMX_REGISTERS (1 << 1)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS == EXCHANGE_FPU_MMX_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS differs from the value of EXCHANGE_FPU_MMX_REGISTERS"
-    );
-#    define EXCHANGE_SSE_REGISTERS (1 << 2)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS == EXCHANGE_SSE_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS differs from the value of EXCHANGE_SSE_REGISTERS"
-    );
-    /* if(settings_make_fxsr_is_eligible(%ebx)) */
-    __asm__ volatile("test $(" __asm__STR(EXCHANGE_FPU_MMX_REGISTERS) "|" __asm__STR(EXCHANGE_SSE_REGISTERS) "), %ebx");
-    __asm__ volatile("jz .Lno_store_fpu_mmx_sse_registers"); /* then */
-#    if !CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-    __asm__ volatile("addl $4, %ecx"); /* %ecx = &prev->context.fxsr; // 16-byte aligned*/
-#    else
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_EFLAGS_REGISTER) ", %ebx"); /* if (settings & EXCHANGE_EFLAGS_REGISTER) */
-    __asm__ volatile("jnz .Lno_pad_fxsr_storage");                            /* then */
-    __asm__ volatile("addl $4, %ecx");                                        /* %ecx = &prev->context.fxsr; // 16-byte aligned */
-    __asm__ volatile(".Lno_pad_fxsr_storage:");                               /* else */
-#    endif
-    __asm__ volatile("pushl %edx");
-    if(cco_x86_has_fxsr) {                   /* if (has_fxsr) */
-        __asm__ volatile("fxsave (%ecx)");   /* fxsave(prev->context.fxsr); */
-        __asm__ volatile("addl $512, %ecx"); /* %ecx = (&prev->context.eflags + 1); */
-    }
-    else {
-        // TODO: store FPU/MMX and SSE registers one by one
-    }
-    __asm__ volatile("popl %edx");
-    __asm__ volatile(".Lno_store_fpu_mmx_sse_registers:");
-#  elif CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE
-#    define EXCHANGE_FPU_MMX_REGISTERS (1 << 1)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS == EXCHANGE_FPU_MMX_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS differs from the value of EXCHANGE_FPU_MMX_REGISTERS"
-    );
-    __asm__ volatile("test $(" __asm__STR(EXCHANGE_FPU_MMX_REGISTERS) "), %ebx"); /* if(settings & exchange_fpu_mmx) */
-    __asm__ volatile("jz .Lno_store_fpu_mmx_registers");                          /* then */
-    // TODO: store FPU/MMX registers one by one
-    __asm__ volatile(".Lno_store_fpu_mmx_registers:"); /* else */
-#  elif CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
-#    define EXCHANGE_SSE_REGISTERS (1 << 2)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS == EXCHANGE_SSE_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS differs from the value of EXCHANGE_SSE_REGISTERS"
-    );
-    __asm__ volatile("test %(" __asm__STR(EXCHANGE_SSE_REGISTERS) "), %ebx"); /* if(settings & exchange_sse) */
-    __asm__ volatile("jz .Lno_store_sse_registers");                          /* then */
-    // TODO: store SSE registers one by one
-    // __asm__ volatile("addl $128, %ecx");
-    __asm__ volatile(".Lno_store_sse_registers:"); /* else */
+        [1] = cco_cswitch_eflags_fpcontrol,
 #  endif
-
 #  if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
-#    define EXCHANGE_SEGMENT_REGISTERS (1 << 3)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS == EXCHANGE_SEGMENT_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS differs from the value of EXCHANGE_SEGMENT_REGISTERS"
-    );
-    /* if(settings & CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS) { */
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_SEGMENT_REGISTERS) ", %ebx"); /* if(settings & exchange_segment) */
-    __asm__ volatile("jz .Lno_store_segment_registers");                        /* then */
-    __asm__ volatile("movw %cs, 0x00(%ecx)");                                   /* prev->context.cs = %cs; */
-    __asm__ volatile("movw %ds, 0x02(%ecx)");                                   /* prev->context.ds = %ds; */
-    __asm__ volatile("movw %ss, 0x04(%ecx)");                                   /* prev->context.ss = %ss; */
-    __asm__ volatile("movw %es, 0x06(%ecx)");                                   /* prev->context.es = %es; */
-    __asm__ volatile("movw %fs, 0x08(%ecx)");                                   /* prev->context.fs = %fs; */
-    __asm__ volatile("movw %gs, 0x0a(%ecx)");                                   /* prev->context.gs = %gs; */
-    __asm__ volatile("addl $12, %ecx");                                         /* %ecx = (&prev->context.gs + 1); */
-    __asm__ volatile(".Lno_store_segment_registers:");                          /* else */
+        [2] = cco_cswitch_segment_fpcontrol,
 #  endif
-
-#  if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE
-#    define EXCHANGE_DEBUG_REGISTERS (1 << 4)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_DEBUG_REGISTERS == EXCHANGE_DEBUG_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_DEBUG_REGISTERS differs from the value of EXCHANGE_DEBUG_REGISTERS"
-    );
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_DEBUG_REGISTERS) ", %ebx"); /* if(settings & exchange_debug) */
-    __asm__ volatile("jz .Lno_store_debug_registers");                        /* then */
-    __asm__ volatile("movl %dr0, 0x00(%ecx)");                                /* prev->context.dr0 = %dr0; */
-    __asm__ volatile("movl %dr1, 0x04(%ecx)");                                /* prev->context.dr1 = %dr1; */
-    __asm__ volatile("movl %dr2, 0x08(%ecx)");                                /* prev->context.dr2 = %dr2; */
-    __asm__ volatile("movl %dr3, 0x0c(%ecx)");                                /* prev->context.dr3 = %dr3; */
-    __asm__ volatile("movl %dr6, 0x10(%ecx)");                                /* prev->context.dr6 = %dr6; */
-    __asm__ volatile("movl %dr7, 0x14(%ecx)");                                /* prev->context.dr7 = %dr7; */
-    __asm__ volatile("addl $24, %ecx");                                       /* %ecx = (&prev->context.dr7 + 1); */
-    __asm__ volatile(".Lno_store_debug_registers:");                          /* else */
+#  if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+        [3] = cco_cswitch_eflags_segment_fpcontrol,
 #  endif
-
-#  if CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE
-#    define EXCHANGE_CONTROL_REGISTERS (1 << 5)
-    _Static_assert(
-        CCO_SETTINGS_x86_EXCHANGE_CONTROL_REGISTERS == EXCHANGE_CONTROL_REGISTERS,
-        "The value of CCO_SETTINGS_x86_EXCHANGE_CONTROL_REGISTERS differs from the value of EXCHANGE_CONTROL_REGISTERS"
-    );
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_CONTROL_REGISTERS) ", %ebx"); /* if(settings & exchange_control) */
-    __asm__ volatile("jz .Lno_store_control_registers");                        /* then */
-    __asm__ volatile("movl %cr0, 0x00(%ecx)");                                  /* prev->context.cr0 = %cr0; */
-    __asm__ volatile("movl %cr2, 0x04(%ecx)");                                  /* prev->context.cr2 = %cr2; */
-    __asm__ volatile("movl %cr3, 0x08(%ecx)");                                  /* prev->context.cr3 = %cr3; */
-    __asm__ volatile("movl %cr4, 0x0c(%ecx)");                                  /* prev->context.cr4 = %cr4; */
-    __asm__ volatile("movl %cr8, 0x10(%ecx)");                                  /* prev->context.cr8 = %cr8; */
-    __asm__ volatile(".Lno_store_control_registers:");                          /* else */
-#  endif
-
-#  if !CCO_x86_BARE_CSWITCH
-    __asm__ volatile("movl 4(%edx), %ecx"); /* %ecx = next->settings; */
-#  endif
-    // TODO consider using pusha/popa
-    __asm__ volatile("movl (%edx), %edx");                               /* %edx = next->context; */
-    __asm__ volatile("movl 0x10(%edx), %esp");                           /* %esp = next->context.esp; */
-    __asm__ volatile("movl 0x14(%edx), %edi \n\t movl %edi, 0x0(%esp)"); /* *%esp = next->context.eip; // for ret */
-    __asm__ volatile("movl 0x0c(%edx), %ebp");                           /* %ebp = next->context.ebp; */
-    __asm__ volatile("movl 0x08(%edx), %edi");                           /* %edi = next->context.edi; */
-    __asm__ volatile("movl 0x04(%edx), %esi");                           /* %esi = next->context.esi; */
-    __asm__ volatile("movl 0x00(%edx), %ebx");                           /* %ebx = next->context.ebx; */
-#  if !CCO_x86_BARE_CSWITCH
-    __asm__ volatile("addl $28, %edx"); /* %edx = (&next->context.eip + 1); */
-#  endif
-
+    },
+#endif
+#if CCO_x86_ENABLE_FPU_EXCHANGE
+    [CCO_x86_FPU_FXSAVE] = {
+        [0] = cco_cswitch_fpu,
 #  if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_EFLAGS_REGISTER) ", %ecx"); /* if (settings & EXCHANGE_EFLAGS_REGISTER) */
-    __asm__ volatile("jz .Lno_restore_flags_registers");                      /* then */
-    __asm__ volatile("push (%edx)");                                          /* push(next->context.eflags); */
-    __asm__ volatile("popf");                                                 /* %eflags = pop(); */
-    __asm__ volatile("addl $4, %edx");                                        /* %edx = (&next->context.eflags + 1); */
-    __asm__ volatile(".Lno_restore_flags_registers:");                        /* else */
+        [1] = cco_cswitch_eflags_fpu,
 #  endif
-
-#  if CCO_x86_ELIGIBLE_FOR_FXSR
-    __asm__ volatile("test $(" __asm__STR(EXCHANGE_FPU_MMX_REGISTERS) "|" __asm__STR(EXCHANGE_SSE_REGISTERS) "), %ecx");
-    __asm__ volatile("jz .Lno_restore_fpu_mmx_sse_registers");
-#    if !CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
-    __asm__ volatile("addl $4, %edx"); /* %edx = &next->context.fxsr; // 16-byte aligned */
-#    else
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_EFLAGS_REGISTER) ", %ecx"); /* if (settings & EXCHANGE_EFLAGS_REGISTER) */
-    __asm__ volatile("jnz .Lno_pad_fxsr_restore");                            /* then */
-    __asm__ volatile("addl $4, %edx");                                        /* %edx = &next->context.fxsr; // 16-byte aligned */
-    __asm__ volatile(".Lno_pad_fxsr_restore:");                               /* else */
-#    endif
-    if(cco_x86_has_fxsr) {
-        __asm__ volatile("fxrstor (%edx)");
-        __asm__ volatile("addl $512, %edx");
-    }
-    else {
-        // TODO: store FPU/MMX and SSE registers one by one
-    }
-    __asm__ volatile(".Lno_restore_fpu_mmx_sse_registers:");
-#  elif CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE
-    __asm__ volatile("test $(" __asm__STR(EXCHANGE_FPU_MMX_REGISTERS) "), %ecx");
-    __asm__ volatile("jz .Lno_restore_fpu_mmx_registers");
-    __asm__ volatile(".Lno_restore_fpu_mmx_registers:");
-#  elif CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
-    __asm__ volatile("test %(" __asm__STR(EXCHANGE_SSE_REGISTERS) "), %ecx");
-    __asm__ volatile("jz .Lno_restore_sse_registers");
-    __asm__ volatile(".Lno_restore_sse_registers:");
-#  endif
-
 #  if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_SEGMENT_REGISTERS) ", %ecx");
-    __asm__ volatile("jz .Lno_restore_segment_registers");
-    __asm__ volatile("movw %cs, 0x00(%edx)"); /* prev->context.cs = %cs; */
-    __asm__ volatile("movw %ds, 0x02(%edx)"); /* prev->context.ds = %ds; */
-    __asm__ volatile("movw %ss, 0x04(%edx)"); /* prev->context.ss = %ss; */
-    __asm__ volatile("movw %es, 0x06(%edx)"); /* prev->context.es = %es; */
-    __asm__ volatile("movw %fs, 0x08(%edx)"); /* prev->context.fs = %fs; */
-    __asm__ volatile("movw %gs, 0x0a(%edx)"); /* prev->context.gs = %gs; */
-    __asm__ volatile("addl $12, %edx");       /* %ecx = (&prev->context.gs + 1); */
-    __asm__ volatile(".Lno_restore_segment_registers:");
+        [2] = cco_cswitch_segment_fpu,
 #  endif
-
-#  if CCO_x86_ENABLE_DEBUG_REGISTERS_EXCHANGE
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_DEBUG_REGISTERS) ", %ecx");
-    __asm__ volatile("jz .Lno_restore_debug_registers");
-    __asm__ volatile("movl %dr0, 0x00(%edx)"); /* prev->context.dr0 = %dr0; */
-    __asm__ volatile("movl %dr1, 0x04(%edx)"); /* prev->context.dr1 = %dr1; */
-    __asm__ volatile("movl %dr2, 0x08(%edx)"); /* prev->context.dr2 = %dr2; */
-    __asm__ volatile("movl %dr3, 0x0c(%edx)"); /* prev->context.dr3 = %dr3; */
-    __asm__ volatile("movl %dr6, 0x10(%edx)"); /* prev->context.dr6 = %dr6; */
-    __asm__ volatile("movl %dr7, 0x14(%edx)"); /* prev->context.dr7 = %dr7; */
-    __asm__ volatile("addl $24, %edx");        /* %ecx = (&prev->context.dr7 + 1); */
-    __asm__ volatile(".Lno_restore_debug_registers:");
-#  endif
-
-#  if CCO_x86_ENABLE_CONTROL_REGISTERS_EXCHANGE
-    __asm__ volatile("test $" __asm__STR(EXCHANGE_CONTROL_REGISTERS) ", %ecx");
-    __asm__ volatile("jz .Lno_restore_control_registers");
-    __asm__ volatile("movl %cr0, 0x00(%edx)"); /* prev->context.cr0 = %cr0; */
-    __asm__ volatile("movl %cr2, 0x04(%edx)"); /* prev->context.cr2 = %cr2; */
-    __asm__ volatile("movl %cr3, 0x08(%edx)"); /* prev->context.cr3 = %cr3; */
-    __asm__ volatile("movl %cr4, 0x0c(%edx)"); /* prev->context.cr4 = %cr4; */
-    __asm__ volatile("movl %cr8, 0x10(%edx)"); /* prev->context.cr8 = %cr8; */
-    __asm__ volatile(".Lno_restore_control_registers:");
+#  if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE && CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+        [3] = cco_cswitch_eflags_segment_fpu,
 #  endif
-    __asm__ volatile("ret");
-#elif defined(_MSC_VER)
-#elif defined(__ICC) || defined(__INTEL_COMPILER)
-#else
-#  error Unsupported compiler
+    },
 #endif
-}
+};
 
-#if CCO_x86_ELIGIBLE_FOR_FXSR
-CCO_PRIVATE void ctor
-cco_cpu_context_init()
+/**
+ * @brief Selects the context switch routine matching @p settings.
+ *
+ * @details Only the bits of the registers enabled at compile time are considered, so that the index always refers to
+ * a routine which has been assembled. The FXSAVE area already holds the control words: the floating-point control
+ * setting only matters when the area is not exchanged.
+ *
+ * @param settings the settings of the coroutine
+ * @return cco_cswitch_routine the routine the coroutine shall be suspended with
+ */
+CCO_PRIVATE always_inline cco_cswitch_routine
+cco_select_cswitch(const cco_architecture_specific_settings* settings)
 {
-    cco_x86_has_fxsr = cco_x86_retrieve_has_fxsr();
-}
+    unsigned int fpu   = CCO_x86_FPU_NONE;
+    unsigned int index = 0;
+#if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+    index |= (*settings & CCO_x86_EFLAGS_SETTINGS) ? 1 : 0;
+#endif
+#if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+    index |= (*settings & CCO_x86_SEGMENT_SETTINGS) ? 2 : 0;
 #endif
+#if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    fpu = (*settings & CCO_x86_FP_CONTROL_SETTINGS) ? CCO_x86_FPU_CONTROL : fpu;
+#endif
+#if CCO_x86_ENABLE_FPU_EXCHANGE
+    fpu = (*settings & CCO_x86_FPU_SETTINGS) ? CCO_x86_FPU_FXSAVE : fpu;
+#endif
+    (void)settings;
+    return cco_cswitch_routines[fpu][index];
+}
 
 CCO_PRIVATE always_inline uint8_t*
 cco_current_stack_pointer(void)
@@ -610,4 +457,6 @@ cco_get_stack_pointer(const cco_coroutine* coroutine)
     return (uint8_t*)coroutine->context->esp;
 }
 
+#endif /* __ASSEMBLER__ */
+
 #endif
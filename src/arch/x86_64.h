@@ -0,0 +1,568 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CCO_SRC_ARCH_x86_64_H_INCLUDED
+#define CCO_SRC_ARCH_x86_64_H_INCLUDED
+
+#if !defined(CCO_COROUTINE_IMPLEMENTATION) && !defined(__ASSEMBLER__)
+#  error "This file was designed to be included from coroutine.c or x86_64.S directly"
+#endif
+
+#if CCO_x86_64_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+/* Reloading %fs/%gs from user space resets the TLS base on x86_64, and the selectors carry no other useful state. */
+#  error "Segment registers exchange is not supported on x86_64"
+#endif
+#if CCO_x86_64_ENABLE_DEBUG_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_CONTROL_REGISTERS_EXCHANGE
+#  error "Debug and control registers are only accessible at CPL 0 and cannot be exchanged on x86_64"
+#endif
+
+/* The following definitions are shared with x86_64.S. */
+
+#define CCO_x86_64_BARE_CSWITCH                                                                                                  \
+  (!(CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE || CCO_x86_64_ENABLE_FPU_MMX_REGISTERS_EXCHANGE                                  \
+     || CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE                                     \
+     || CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE))
+
+#define CCO_x86_64_ENABLE_FPU_EXCHANGE                                                                                           \
+  (CCO_x86_64_ENABLE_FPU_MMX_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE                                      \
+   || CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE)
+
+#define CCO_x86_64_USE_XSAVE (CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE)
+
+/** Whether some coroutine may own the floating-point control words, and keep the ones of the outer context aside. */
+#define CCO_x86_64_OUTER_FP_CONTROL (CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_FPU_EXCHANGE)
+
+/** Offsets of the optional fields of cco_cpu_context, see the struct documentation. */
+#define CCO_x86_64_CONTEXT_RFLAGS_OFFSET     0x40
+#define CCO_x86_64_CONTEXT_XSAVE_MASK_OFFSET 0x48
+#define CCO_x86_64_CONTEXT_FP_CONTROL_OFFSET       0x50
+#define CCO_x86_64_CONTEXT_OUTER_FP_CONTROL_OFFSET 0x56
+#define CCO_x86_64_CONTEXT_FPU_OFFSET              0x80
+
+/** Plain-number copies of the settings bits, usable from x86_64.S. */
+#define CCO_x86_64_RFLAGS_SETTINGS     0x01
+#define CCO_x86_64_FPU_SETTINGS        0xc6 /* FPU/MMX | SSE | AVX | AVX-512: settings that require the FPU area to be saved */
+#define CCO_x86_64_FP_CONTROL_SETTINGS 0x100
+
+/* XSAVE state components enabled at compile time, and the standard-format area size up to the last one of them. */
+#if CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE
+#  define CCO_x86_64_XSAVE_MASK    0xe7          /* x87 | SSE | AVX | opmask | ZMM_Hi256 | Hi16_ZMM */
+#  define CCO_x86_64_FPU_AREA_SIZE (1664 + 1024) /* standard-format offset of Hi16_ZMM, plus its size */
+#elif CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE
+#  define CCO_x86_64_XSAVE_MASK    0x07        /* x87 | SSE | AVX */
+#  define CCO_x86_64_FPU_AREA_SIZE (576 + 256) /* standard-format offset of AVX, plus its size */
+#else
+#  define CCO_x86_64_FPU_AREA_SIZE 512
+#endif
+
+/**
+ * Instructions the floating-point state can be saved with, as assembled in x86_64.S: CONTROL only stores the x87
+ * control word and MXCSR, the other ones the whole FPU area. XRSTOR restores all of the XSAVE ones.
+ */
+#define CCO_x86_64_FPU_NONE     0
+#define CCO_x86_64_FPU_CONTROL  1
+#define CCO_x86_64_FPU_FXSAVE   2
+#define CCO_x86_64_FPU_XSAVE    3
+#define CCO_x86_64_FPU_XSAVEOPT 4
+#define CCO_x86_64_FPU_XSAVEC   5
+
+/** Alignment of the buffer holding a cco_cpu_context, as required by XSAVE (FXSAVE only requires 16 bytes). */
+#define CCO_CPU_CONTEXT_ALIGNMENT 64
+
+#ifndef __ASSEMBLER__
+
+#if CCO_x86_64_USE_XSAVE
+#  if defined(__GNUC__) || defined(__clang__)
+#    include <cpuid.h>
+#  else
+#    error Unsupported compiler
+#  endif
+#endif
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Basic x86_64 registers struct.
+ *
+ * @details Only the registers the System V AMD64 ABI defines as callee-saved are stored: the other general purpose
+ * registers are already considered clobbered by the caller of cco_cswitch(). Like on x86, the struct is the head of a
+ * buffer whose size is computed at runtime from the settings of the coroutine (see cco_get_cpu_context_size()).
+ */
+struct cco_cpu_context {
+    void* rbx; /* 0x00 */
+    void* rbp; /* 0x08 */
+    void* r12; /* 0x10 */
+    void* r13; /* 0x18 */
+    void* r14; /* 0x20 */
+    void* r15; /* 0x28 */
+    void* rsp; /* 0x30 */
+    void* rip; /* 0x38 */
+
+    /*  The following fields are only present if at least one of the optional registers is enabled at compile time.
+        The header is padded to 64 bytes, so that the FPU area is 64-byte aligned as required by XSAVE/XRSTOR.
+
+    uint64_t rflags;                                            // 0x40
+    uint64_t xsave_mask;                                        // 0x48, EDX:EAX operand of XSAVE and XRSTOR
+
+        Floating-point control state, the only part of it the ABI requires to be preserved across calls: a cheaper
+        alternative to the FPU area for coroutines changing the rounding mode or the exception masks only.
+
+    uint32_t mxcsr;                                             // 0x50
+    uint16_t fpucw;                                             // 0x54
+
+        Floating-point control words of the outer context, recorded when the coroutine is switched to and loaded back
+        when it is suspended, by the coroutines owning the control words or the FPU area (see cco_cswitch_bare()).
+
+    uint16_t outer_fpucw;                                       // 0x56
+    uint32_t outer_mxcsr;                                       // 0x58
+    uint8_t  padding[36];                                       // 0x5c
+
+        FPU/MMX and SSE registers share the same area; FXSAVE is used unless AVX or AVX-512 exchange is enabled,
+        in which case the best XSAVE variant supported by the CPU is used instead (see cco_init_cpu_features()),
+        restricted to the state components the coroutine asked for. The size of the area is computed at runtime:
+
+    uint8_t  fpu[512];                                          // 0x80, FXSAVE area
+    uint8_t  fpu[cco_x86_64_xsave_area_size(xsave_mask)];       // 0x80, XSAVE area, standard or compacted format
+    */
+};
+
+#pragma pack(pop)
+
+_Static_assert(
+    CCO_x86_64_RFLAGS_SETTINGS == CCO_SETTINGS_x86_64_EXCHANGE_RFLAGS_REGISTER,
+    "The value of CCO_x86_64_RFLAGS_SETTINGS differs from the value of CCO_SETTINGS_x86_64_EXCHANGE_RFLAGS_REGISTER"
+);
+_Static_assert(
+    CCO_x86_64_FPU_SETTINGS
+        == (CCO_SETTINGS_x86_64_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS
+            | CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS | CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS),
+    "The value of CCO_x86_64_FPU_SETTINGS differs from the FPU/MMX, SSE, AVX and AVX-512 settings"
+);
+_Static_assert(
+    CCO_x86_64_FP_CONTROL_SETTINGS == CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS,
+    "The value of CCO_x86_64_FP_CONTROL_SETTINGS differs from the value of CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS"
+);
+_Static_assert(offsetof(cco_coroutine, context) == 0, "cco_cswitch() expects the context at offset 0 of cco_coroutine");
+
+/**
+ * @brief Thread-local context of the main coroutine.
+ *
+ * @details See the x86 counterpart for the meaning of the main context. It is sized for the worst case allowed by
+ * the compile-time settings: the standard XSAVE format is never smaller than the compacted one.
+ */
+CCO_PRIVATE thread_local _Alignas(CCO_CPU_CONTEXT_ALIGNMENT) uint8_t cco_main_context
+    [sizeof(cco_cpu_context)
+#if !CCO_x86_64_BARE_CSWITCH
+     + (CCO_x86_64_CONTEXT_FPU_OFFSET - sizeof(cco_cpu_context))
+#endif
+#if CCO_x86_64_ENABLE_FPU_EXCHANGE
+     + CCO_x86_64_FPU_AREA_SIZE
+#endif
+] = {0};
+
+_Static_assert(
+    CCO_CPU_CONTEXT_STORAGE_SIZE(~0u) >= sizeof(cco_main_context) + CCO_CPU_CONTEXT_ALIGNMENT - 1,
+    "CCO_CPU_CONTEXT_STORAGE_SIZE() does not bound the size of the context"
+);
+
+#define CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS() &cco_default_x86_64_settings_instance;
+
+CCO_PRIVATE cco_x86_64_settings cco_default_x86_64_settings_instance = 0
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE && CCO_x86_64_RFLAGS_REGISTER_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_RFLAGS_REGISTER
+#endif
+#if CCO_x86_64_ENABLE_FPU_MMX_REGISTERS_EXCHANGE && CCO_x86_64_FPU_MMX_REGISTERS_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_FPU_MMX_REGISTERS
+#endif
+#if CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE && CCO_x86_64_SSE_REGISTERS_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS
+#endif
+#if CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE && CCO_x86_64_AVX_REGISTERS_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS
+#endif
+#if CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE && CCO_x86_64_AVX512_REGISTERS_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS
+#endif
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE && CCO_x86_64_FP_CONTROL_REGISTERS_DEFAULT_EXCHANGE
+                                                                       | CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS
+#endif
+    ;
+
+#if CCO_x86_64_ENABLE_FPU_EXCHANGE
+
+/** @brief Instruction used to save the FPU area, one of CCO_x86_64_FPU_*. Initialized in cco_init() and cached. */
+CCO_PRIVATE unsigned int cco_x86_64_fpu_instruction = CCO_x86_64_FPU_FXSAVE;
+
+#  if CCO_x86_64_USE_XSAVE
+
+/** @brief XSAVE state components enabled by the OS (XCR0) and at compile time. Initialized in cco_init(). */
+CCO_PRIVATE uint64_t cco_x86_64_xsave_features;
+
+/** @brief Standard-format offset, size and 64-byte alignment requirement of each state component, from CPUID 0xD. */
+CCO_PRIVATE struct {
+    uint32_t offset;
+    uint32_t size;
+    bool     aligned;
+} cco_x86_64_xsave_components[8];
+
+/**
+ * @brief Size of the XSAVE area needed to save the state components in @p mask with the cached instruction.
+ *
+ * @details The legacy region and the XSAVE header (576 bytes) are always present. In the standard format the area
+ * ends with the last component of @p mask, while in the compacted format of XSAVEC the components of @p mask are
+ * packed one after the other, each one aligned to 64 bytes if the CPU requires it.
+ *
+ * @param mask the requested-feature bitmap
+ * @return size_t the size of the XSAVE area
+ */
+CCO_PRIVATE always_inline size_t
+cco_x86_64_xsave_area_size(uint64_t mask)
+{
+    size_t size = 512 + 64;
+    for(unsigned int i = 2; i != 8; ++i) {
+        if(mask & ((uint64_t)1 << i)) {
+            if(cco_x86_64_fpu_instruction == CCO_x86_64_FPU_XSAVEC) {
+                if(cco_x86_64_xsave_components[i].aligned) {
+                    size = (size + 63) & ~(size_t)63;
+                }
+                size += cco_x86_64_xsave_components[i].size;
+            }
+            else if(cco_x86_64_xsave_components[i].offset + cco_x86_64_xsave_components[i].size > size) {
+                size = cco_x86_64_xsave_components[i].offset + cco_x86_64_xsave_components[i].size;
+            }
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief XSAVE requested-feature bitmap matching @p settings.
+ *
+ * @details The x87 and SSE components are always saved, as they hold the x87 control word and MXCSR: a coroutine
+ * owning the FPU area owns both control words, which the switch replaces with those of the outer context (see
+ * cco_cswitch_bare()). AVX and AVX-512 only store the upper parts of the vector registers, the lower 128 bits being in
+ * the SSE component; components not enabled by the OS are silently dropped.
+ *
+ * @param settings the settings of the coroutine
+ * @return uint64_t the requested-feature bitmap
+ */
+CCO_PRIVATE always_inline uint64_t
+cco_x86_64_xsave_mask(const cco_architecture_specific_settings* settings)
+{
+    uint64_t mask = 0x03; /* x87 | SSE */
+    if(*settings & CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS) {
+        mask |= 0x04; /* AVX */
+    }
+    if(*settings & CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS) {
+        mask |= 0xe4; /* AVX | opmask | ZMM_Hi256 | Hi16_ZMM */
+    }
+    return mask & cco_x86_64_xsave_features;
+}
+
+#  endif
+#endif
+
+/**
+ * @brief Detects the features of the CPU the context switch depends on.
+ *
+ * @details Called once from cco_init(). When AVX or AVX-512 exchange is enabled at compile time, XSAVE is used only if
+ * the OS enabled it (CPUID.1:ECX.OSXSAVE); XSAVEC is then preferred for its compacted area, followed by XSAVEOPT and
+ * plain XSAVE. FXSAVE remains the fallback, since the OS cannot have enabled the AVX state without XSAVE.
+ */
+CCO_PRIVATE always_inline void
+cco_init_cpu_features(void)
+{
+#if CCO_x86_64_USE_XSAVE
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || __get_cpuid_max(0, NULL) < 0xd) {
+        return;
+    }
+    uint32_t xcr0_low, xcr0_high;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    cco_x86_64_xsave_features = (((uint64_t)xcr0_high << 32) | xcr0_low) & CCO_x86_64_XSAVE_MASK;
+    for(unsigned int i = 2; i != 8; ++i) {
+        if(cco_x86_64_xsave_features & ((uint64_t)1 << i)) {
+            __cpuid_count(0xd, i, eax, ebx, ecx, edx);
+            cco_x86_64_xsave_components[i].size    = eax;
+            cco_x86_64_xsave_components[i].offset  = ebx;
+            cco_x86_64_xsave_components[i].aligned = (ecx & 0x2) != 0;
+        }
+    }
+    __cpuid_count(0xd, 1, eax, ebx, ecx, edx);
+    cco_x86_64_fpu_instruction = (eax & 0x2) ? CCO_x86_64_FPU_XSAVEC
+                               : (eax & 0x1) ? CCO_x86_64_FPU_XSAVEOPT
+                                             : CCO_x86_64_FPU_XSAVE;
+    /* The main context is sized with the architectural offsets: never trust a CPU reporting a larger area. */
+    if(cco_x86_64_xsave_area_size(cco_x86_64_xsave_features) > CCO_x86_64_FPU_AREA_SIZE) {
+        cco_x86_64_fpu_instruction = CCO_x86_64_FPU_FXSAVE;
+        cco_x86_64_xsave_features  = 0;
+    }
+#endif
+}
+
+CCO_PRIVATE always_inline size_t
+cco_get_cpu_context_size(const cco_architecture_specific_settings* settings)
+{
+    // clang-format off
+#if CCO_x86_64_BARE_CSWITCH
+    (void) settings;
+    return sizeof(struct cco_cpu_context);
+#else
+    return
+#   if CCO_x86_64_USE_XSAVE
+    (*settings & CCO_x86_64_FPU_SETTINGS) && cco_x86_64_fpu_instruction != CCO_x86_64_FPU_FXSAVE ?
+        CCO_x86_64_CONTEXT_FPU_OFFSET + cco_x86_64_xsave_area_size(cco_x86_64_xsave_mask(settings)) :
+#   endif
+#   if CCO_x86_64_ENABLE_FPU_EXCHANGE
+    (*settings & CCO_x86_64_FPU_SETTINGS) ? CCO_x86_64_CONTEXT_FPU_OFFSET + 512 :
+#   endif
+#   if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    (*settings & CCO_x86_64_FP_CONTROL_SETTINGS) ? CCO_x86_64_CONTEXT_OUTER_FP_CONTROL_OFFSET + sizeof(uint16_t) + sizeof(uint32_t) :
+#   endif
+#   if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+    (*settings & CCO_x86_64_RFLAGS_SETTINGS) ? CCO_x86_64_CONTEXT_RFLAGS_OFFSET + sizeof(uint64_t) :
+#   endif
+    sizeof(struct cco_cpu_context);
+#endif
+    // clang-format on
+}
+
+/**
+ * @brief Initializes the parts of a freshly allocated CPU context which outlive a restart of the coroutine.
+ *
+ * @details With XSAVE, the requested-feature bitmap derived from the settings is stored in the context, where the
+ * switch routine loads it from. XRSTOR faults on a non-zero XCOMP_BV or reserved header bytes, while XSAVE and
+ * XSAVEOPT only write XSTATE_BV: the header is cleared here instead of relying on the allocator to return zeroed
+ * memory.
+ *
+ * The control words of the outer context start as the current ones. They only matter for the main coroutine, which
+ * is never entered through cco_fp_entry_point() and runs on the thread setting it up: the other coroutines record
+ * them again each time they are started.
+ *
+ * @param coroutine The coroutine whose context shall be initialized, including the main one
+ */
+CCO_PRIVATE always_inline void
+cco_init_cpu_context(cco_coroutine* coroutine)
+{
+#if CCO_x86_64_USE_XSAVE
+    if((coroutine->settings & CCO_x86_64_FPU_SETTINGS) && cco_x86_64_fpu_instruction != CCO_x86_64_FPU_FXSAVE) {
+        uint8_t* ctx                                             = (uint8_t*)coroutine->context;
+        *(uint64_t*)(ctx + CCO_x86_64_CONTEXT_XSAVE_MASK_OFFSET) = cco_x86_64_xsave_mask(&coroutine->settings);
+        for(size_t i = 0; i != 64; ++i) {
+            ctx[CCO_x86_64_CONTEXT_FPU_OFFSET + 512 + i] = 0;
+        }
+    }
+#endif
+#if CCO_x86_64_OUTER_FP_CONTROL
+    if(coroutine->settings & (CCO_x86_64_FP_CONTROL_SETTINGS | CCO_x86_64_FPU_SETTINGS)) {
+        uint8_t* ctx = (uint8_t*)coroutine->context;
+        __asm__ volatile("fnstcw %0" : "=m"(*(uint16_t*)(ctx + CCO_x86_64_CONTEXT_OUTER_FP_CONTROL_OFFSET + 0)));
+        __asm__ volatile("stmxcsr %0" : "=m"(*(uint32_t*)(ctx + CCO_x86_64_CONTEXT_OUTER_FP_CONTROL_OFFSET + 2)));
+    }
+#endif
+#if !CCO_x86_64_USE_XSAVE && !CCO_x86_64_OUTER_FP_CONTROL
+    (void)coroutine;
+#endif
+}
+
+#if CCO_x86_64_OUTER_FP_CONTROL
+/**
+ * @brief First entry of a coroutine owning floating-point control words, implemented in x86_64.S.
+ *
+ * @details Jumped to in place of cco_coroutine_entry_point(), whose address it finds in %rbx: it records the control
+ * words of the outer context in the context of the coroutine (%r9), as the resume label of its routine does on the
+ * following switches.
+ */
+hidden void cco_fp_entry_point(void);
+#endif
+
+/**
+ * @brief Prepares the CPU context for the first call to cco_cswitch().
+ *
+ * @details The stack is set up as if cco_coroutine_entry_point had just been called: the stack pointer is aligned to
+ * 16 bytes before the (null) return address is pushed, as required by the ABI at function entry. The coroutine pointer
+ * is passed in %rdi by cco_cswitch() itself, which always loads the next coroutine in the first argument register. A
+ * coroutine owning floating-point control words is entered through cco_fp_entry_point() instead.
+ *
+ * @param coroutine The coroutine whose context shall be prepared
+ */
+CCO_PRIVATE always_inline void
+cco_prepare_coroutine(cco_coroutine* coroutine)
+{
+    cco_cpu_context* ctx = coroutine->context;
+    uintptr_t        top = ((uintptr_t)(coroutine->stack + coroutine->stack_size)) & ~(uintptr_t)15;
+    ctx->rsp             = (void*)(top - sizeof(void*));
+    *(void**)ctx->rsp    = NULL;
+    ctx->rbp             = NULL;
+    ctx->rip             = (void*)(uintptr_t)cco_coroutine_entry_point;
+#if CCO_x86_64_OUTER_FP_CONTROL
+    if(coroutine->settings & (CCO_x86_64_FP_CONTROL_SETTINGS | CCO_x86_64_FPU_SETTINGS)) {
+        ctx->rbx = ctx->rip;
+        ctx->rip = (void*)(uintptr_t)cco_fp_entry_point;
+    }
+#endif
+}
+
+/**
+ * @brief Stores the current CPU context in @p prev and loads the one stored in @p next.
+ *
+ * @details The callee-saved general purpose registers, the stack pointer and the resume address are always exchanged.
+ * The optional registers are saved by the coroutine being suspended before the stack is switched; the resume address
+ * stored in @p prev points right after the jump to @p next, where the same coroutine restores them once it is switched
+ * back to. A coroutine therefore always finds its own optional state intact, while a bare switch never touches it.
+ *
+ * The ABI requires the control bits of MXCSR and of the x87 control word to be preserved across calls, and the caller
+ * of cco_cswitch() may be bare: a coroutine owning them (with the control words or the FPU area) records the ones it
+ * finds when it is switched to, before restoring its own, and loads them back once it has saved its own. Its control
+ * words never leak into another context, which finds the ones that were live when the coroutine was switched to.
+ *
+ * There is one routine for each combination of optional registers enabled at compile time and of instruction the FPU
+ * area can be saved with, each one exchanging its registers unconditionally: a coroutine always suspends through the
+ * routine selected from its settings at creation time (see cco_select_cswitch()), and the routine of @p next is not
+ * involved.
+ *
+ * When jumping to @p next, %rdi is loaded with @p next: this is the argument of cco_coroutine_entry_point() for a
+ * coroutine which is started for the first time, and it is ignored otherwise.
+ *
+ * @p value is carried through the switch in %r10, which no routine touches otherwise, and returned by the call to
+ * cco_cswitch() @p next was suspended in: values are handed over with no memory access at all.
+ *
+ * @note Implemented in x86_64.S, so that the optimizer can neither reorder nor inline them.
+ *
+ * @param prev the coroutine to suspend, whose CPU context is stored (%rdi)
+ * @param next the coroutine to resume, whose CPU context is loaded (%rsi)
+ * @param value the value to hand over to @p next (%rdx)
+ * @return void* the value handed over by the coroutine resuming @p prev (%rax)
+ */
+hidden cswitch_abi void* cco_cswitch_bare(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_rflags(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE && CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_rflags_fpcontrol(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_fxsave(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE && CCO_x86_64_ENABLE_FPU_EXCHANGE
+hidden cswitch_abi void* cco_cswitch_rflags_fxsave(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_USE_XSAVE
+hidden cswitch_abi void* cco_cswitch_xsave(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+hidden cswitch_abi void* cco_cswitch_xsaveopt(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+hidden cswitch_abi void* cco_cswitch_xsavec(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE && CCO_x86_64_USE_XSAVE
+hidden cswitch_abi void* cco_cswitch_rflags_xsave(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+hidden cswitch_abi void* cco_cswitch_rflags_xsaveopt(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+hidden cswitch_abi void* cco_cswitch_rflags_xsavec(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+#endif
+
+/** Context switch routines, indexed by the instruction saving the floating-point state (CCO_x86_64_FPU_*) and RFLAGS. */
+CCO_PRIVATE const cco_cswitch_routine cco_cswitch_routines[6][2] = {
+    [CCO_x86_64_FPU_NONE] = {cco_cswitch_bare,
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                             cco_cswitch_rflags
+#endif
+    },
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    [CCO_x86_64_FPU_CONTROL] = {cco_cswitch_fpcontrol,
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                                cco_cswitch_rflags_fpcontrol
+#  endif
+    },
+#endif
+#if CCO_x86_64_ENABLE_FPU_EXCHANGE
+    [CCO_x86_64_FPU_FXSAVE] = {cco_cswitch_fxsave,
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                               cco_cswitch_rflags_fxsave
+#  endif
+    },
+#endif
+#if CCO_x86_64_USE_XSAVE
+    [CCO_x86_64_FPU_XSAVE] = {cco_cswitch_xsave,
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                              cco_cswitch_rflags_xsave
+#  endif
+    },
+    [CCO_x86_64_FPU_XSAVEOPT] = {cco_cswitch_xsaveopt,
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                                 cco_cswitch_rflags_xsaveopt
+#  endif
+    },
+    [CCO_x86_64_FPU_XSAVEC] = {cco_cswitch_xsavec,
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+                               cco_cswitch_rflags_xsavec
+#  endif
+    },
+#endif
+};
+
+/**
+ * @brief Selects the context switch routine matching @p settings.
+ *
+ * @details Only the bits of the registers enabled at compile time are considered, and the FPU area is saved with the
+ * instruction detected by cco_init_cpu_features(), so that the routine always exists. The FPU area already holds the
+ * control words: the floating-point control setting only matters when the area is not exchanged.
+ *
+ * @param settings the settings of the coroutine
+ * @return cco_cswitch_routine the routine the coroutine shall be suspended with
+ */
+CCO_PRIVATE always_inline cco_cswitch_routine
+cco_select_cswitch(const cco_architecture_specific_settings* settings)
+{
+    unsigned int fpu    = CCO_x86_64_FPU_NONE;
+    unsigned int rflags = 0;
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    fpu = (*settings & CCO_x86_64_FP_CONTROL_SETTINGS) ? CCO_x86_64_FPU_CONTROL : CCO_x86_64_FPU_NONE;
+#endif
+#if CCO_x86_64_ENABLE_FPU_EXCHANGE
+    fpu = (*settings & CCO_x86_64_FPU_SETTINGS) ? cco_x86_64_fpu_instruction : fpu;
+#endif
+#if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+    rflags = (*settings & CCO_x86_64_RFLAGS_SETTINGS) ? 1 : 0;
+#endif
+    (void)settings;
+    return cco_cswitch_routines[fpu][rflags];
+}
+
+CCO_PRIVATE always_inline uint8_t*
+cco_current_stack_pointer(void)
+{
+#if defined(__GNUC__) || defined(__clang__) || defined(__ICC) || defined(__INTEL_COMPILER)
+    uint8_t* sp;
+    __asm__ volatile("movq %%rsp, %0" : "=r"(sp));
+    return sp;
+#else
+#  error Unsupported compiler
+#endif
+}
+
+CCO_PRIVATE always_inline uint8_t*
+cco_get_stack_pointer(const cco_coroutine* coroutine)
+{
+    return (uint8_t*)coroutine->context->rsp;
+}
+
+#endif /* __ASSEMBLER__ */
+
+#endif
+
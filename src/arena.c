@@ -0,0 +1,213 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/arena.c
+ *
+ * @brief Huge-page backed arena, see cco_arena.
+ *
+ * @details The unused part of the region is the range between the stacks carved from its bottom and the contexts carved
+ * from its top. Freed slots are pushed to a free list threaded through their first bytes, which are not touched until
+ * the slot is handed out again.
+ */
+
+#include "errno.h"
+#include "memory.h"
+
+struct cco_arena {
+    cco_allocator allocator;
+    uint8_t*      region;
+    size_t        capacity;
+    bool          huge;
+    size_t        stack_size;
+    size_t        stack_stride; /* stack_size plus one cache line, see CCO_ARENA_STACK_COLOR */
+    size_t        context_size;
+    uint8_t*      low;  /* the lowest byte not yet carved */
+    uint8_t*      high; /* the byte past the highest one not yet carved */
+    void*         free_stacks;
+    void*         free_contexts;
+};
+
+/** Alignment of the contexts carved from an arena, enough for the one of any CPU context. */
+#define CCO_ARENA_CONTEXT_ALIGNMENT 64
+
+/**
+ * Gap between consecutive stacks. With page-multiple stacks laid out back to back, the top of every stack, where the
+ * hottest frames are, would map to the same cache sets: shifting each one by a cache line spreads them over all sets.
+ */
+#define CCO_ARENA_STACK_COLOR 64
+
+/**
+ * @brief Pops a slot from @p free_list, or carves one of @p size bytes from the unused range if there is none.
+ */
+CCO_PRIVATE always_inline void*
+cco_arena_take(cco_arena* arena, void** free_list, size_t size, bool from_top)
+{
+    void* slot = *free_list;
+    if(slot) {
+        *free_list = *(void**)slot;
+    }
+    else if((size_t)(arena->high - arena->low) >= size) {
+        if(from_top) {
+            arena->high -= size;
+            slot = arena->high;
+        }
+        else {
+            slot = arena->low;
+            arena->low += size;
+        }
+    }
+    return slot;
+}
+
+CCO_PRIVATE always_inline void
+cco_arena_give(void** free_list, void* slot)
+{
+    *(void**)slot = *free_list;
+    *free_list    = slot;
+}
+
+CCO_PRIVATE void*
+cco_arena_allocate(void* user_data, size_t size)
+{
+    (void)user_data;
+    return cco_alloc(size);
+}
+
+CCO_PRIVATE void
+cco_arena_deallocate(void* user_data, void* ptr, size_t size)
+{
+    (void)user_data;
+    (void)size;
+    cco_free(ptr);
+}
+
+CCO_PRIVATE void*
+cco_arena_allocate_context(void* user_data, size_t size, size_t alignment)
+{
+    cco_arena* arena = (cco_arena*)user_data;
+    if(size > arena->context_size || alignment > CCO_ARENA_CONTEXT_ALIGNMENT) {
+        return NULL;
+    }
+    return cco_arena_take(arena, &arena->free_contexts, arena->context_size, true);
+}
+
+CCO_PRIVATE void
+cco_arena_deallocate_context(void* user_data, void* ptr, size_t size)
+{
+    (void)size;
+    cco_arena_give(&((cco_arena*)user_data)->free_contexts, ptr);
+}
+
+CCO_PRIVATE void*
+cco_arena_allocate_stack(void* user_data, size_t size)
+{
+    cco_arena* arena = (cco_arena*)user_data;
+    if(size > arena->stack_size) {
+        return NULL;
+    }
+    return cco_arena_take(arena, &arena->free_stacks, arena->stack_stride, false);
+}
+
+CCO_PRIVATE void
+cco_arena_deallocate_stack(void* user_data, void* ptr, size_t size)
+{
+    (void)size;
+    cco_arena_give(&((cco_arena*)user_data)->free_stacks, ptr);
+}
+
+CCO_API_INTERNAL cco_arena*
+cco_arena_create(size_t capacity, size_t stack_size, const cco_architecture_specific_settings* settings)
+{
+    const size_t page_size    = cco_page_size();
+    const size_t context_size = (CCO_CPU_CONTEXT_STORAGE_SIZE(settings ? *settings : ~0u) + CCO_COROUTINE_CONTROL_BLOCK_STORAGE_SIZE
+                                 + CCO_ARENA_CONTEXT_ALIGNMENT - 1)
+                                & ~(size_t)(CCO_ARENA_CONTEXT_ALIGNMENT - 1);
+    if(capacity == 0 || capacity > SIZE_MAX - 2 * CCO_HUGE_PAGE_SIZE || stack_size == 0 || stack_size > SIZE_MAX - page_size) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    capacity   = (capacity + CCO_HUGE_PAGE_SIZE - 1) & ~(CCO_HUGE_PAGE_SIZE - 1);
+    stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+    if(stack_size + CCO_ARENA_STACK_COLOR + context_size > capacity) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+
+    cco_arena* arena = (cco_arena*)cco_alloc(sizeof(cco_arena));
+    if(arena && (arena->region = (uint8_t*)cco_map_huge(capacity, &arena->huge)) == NULL) {
+        cco_free(arena);
+        arena = NULL;
+    }
+    if(!arena) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    arena->allocator.allocate           = cco_arena_allocate;
+    arena->allocator.deallocate         = cco_arena_deallocate;
+    arena->allocator.allocate_context   = cco_arena_allocate_context;
+    arena->allocator.deallocate_context = cco_arena_deallocate_context;
+    arena->allocator.allocate_stack     = cco_arena_allocate_stack;
+    arena->allocator.deallocate_stack   = cco_arena_deallocate_stack;
+    arena->allocator.user_data          = arena;
+    arena->capacity                     = capacity;
+    arena->stack_size                   = stack_size;
+    arena->stack_stride                 = stack_size + CCO_ARENA_STACK_COLOR;
+    arena->context_size                 = context_size;
+    arena->low                          = arena->region;
+    arena->high                         = arena->region + capacity;
+    arena->free_stacks                  = NULL;
+    arena->free_contexts                = NULL;
+    *cco_errno_location()               = CCO_OK;
+    return arena;
+}
+
+CCO_API_INTERNAL void
+cco_arena_destroy(cco_arena* arena)
+{
+    if(arena) {
+        cco_unmap_huge(arena->region, arena->capacity);
+        cco_free(arena);
+        *cco_errno_location() = CCO_OK;
+    }
+    else {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+CCO_API_INTERNAL const cco_allocator*
+cco_arena_get_allocator(cco_arena* arena)
+{
+    if(!arena) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    *cco_errno_location() = CCO_OK;
+    return &arena->allocator;
+}
+
+CCO_API_INTERNAL bool
+cco_arena_uses_huge_pages(const cco_arena* arena)
+{
+    if(!arena) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return false;
+    }
+    *cco_errno_location() = CCO_OK;
+    return arena->huge;
+}
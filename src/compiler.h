@@ -51,6 +51,17 @@
 #  define thread_local _Thread_local
 #endif
 
+/**
+ * TLS model of the thread-local variables read on the hot paths: a fixed offset from the thread pointer, no lookup.
+ * Only applied with INLINE_API, whose header declares the exported ones with the same model: otherwise the default one
+ * is kept, so that the library can still be loaded at runtime with dlopen().
+ */
+#if CCO_INLINE_API && (defined(__GNUC__) || defined(__clang__) || defined(__ICC) || defined(__INTEL_COMPILER))
+#  define initial_exec __attribute__((tls_model("initial-exec")))
+#else
+#  define initial_exec
+#endif
+
 #if defined(__GNUC__) || defined(__clang__) || defined(__ICC) || defined(__INTEL_COMPILER)
 #  define naked  __attribute__((naked))
 #  define unused __attribute__((unused))
@@ -61,4 +72,38 @@
 #  error Unsupported compiler
 #endif
 
+/** Compiler-agnostic macro to define a fastcall calling convention. */
+#if defined(__GNUC__) || defined(__clang__)
+#  define fastcall __attribute__((fastcall))
+#elif defined(_MSC_VER)
+#  define fastcall __fastcall
+#elif defined(__ICC) || defined(__INTEL_COMPILER)
+#  define fastcall __fastcall
+#else
+#  error Unsupported compiler
+#endif
+
+/** Compiler-agnostic macro to force the System V AMD64 calling convention. */
+#if defined(__GNUC__) || defined(__clang__) || defined(__ICC) || defined(__INTEL_COMPILER)
+#  define sysv_abi __attribute__((sysv_abi))
+#endif
+
+/** Calling convention of the context switch routines in src/arch/<arch>.S. */
+#if CCO_TARGET_ARCH == CCO_ARCH_x86
+#  define cswitch_abi fastcall
+#elif CCO_TARGET_ARCH == CCO_ARCH_x86_64
+#  define cswitch_abi sysv_abi
+#else
+#  define cswitch_abi
+#endif
+
+/** Symbols shared among the translation units of the library (including the assembly ones) but never exported. */
+#if defined(__GNUC__) || defined(__clang__) || defined(__ICC) || defined(__INTEL_COMPILER)
+#  define hidden __attribute__((visibility("hidden")))
+#elif defined(_MSC_VER)
+#  define hidden
+#else
+#  error Unsupported compiler
+#endif
+
 #endif
@@ -30,6 +30,9 @@
 #include "errno.h"
 #include "memory.h"
 
+#include <stdatomic.h>
+#include <string.h>
+
 /**
  * @brief Struct describing the context of a CPU.
  * 
@@ -48,293 +51,1553 @@ typedef struct cco_cpu_context cco_cpu_context;
  */
 CCO_PRIVATE void cco_coroutine_entry_point(cco_coroutine* coroutine);
 
+/**
+ * @brief Context switch routine, see cco_cswitch().
+ * 
+ * @details Implemented in assembly in src/arch/<arch>.S: one routine is generated for each combination of optional
+ * registers enabled at compile time, and each coroutine stores the one matching its settings.
+ */
+typedef cswitch_abi void* (*cco_cswitch_routine)(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value);
+
 struct cco_coroutine {
-    cco_cpu_context*                   context;
+    cco_cpu_context*                   context; /* first, read by the cco_cswitch_*() routines */
+    void*                              return_value; /* at CCO_COROUTINE_RETURN_VALUE_OFFSET, see cco/inline.h */
+    _Atomic cco_coroutine_state        state; /* at CCO_COROUTINE_STATE_OFFSET, see cco_coroutine_load_state() */
+    _Atomic bool                       released; /* handed over to another thread, see cco_coroutine_release() */
+    bool                               spawned; /* queued by cco_spawn(), to be started by cco_scheduler_run() */
+    cco_scheduler*                     scheduler; /* whose ready queue it is in, linked through next, NULL if none */
     cco_architecture_specific_settings settings;
+    cco_cswitch_routine                cswitch;
     cco_coroutine*                     caller;
     cco_coroutine_callback             callback;
     void*                              arg;
-    void*                              return_value;
-    cco_coroutine_state                state;
     size_t                             stack_size;
     uint8_t*                           stack;
+    cco_coroutine_flags                flags;
+    const cco_allocator*               allocator; /* NULL for the default one, see cco_allocator */
+    cco_coroutine*                     next; /* next coroutine in the free list of a cco_pool or in a run queue */
+    cco_shared_stack*                  shared_stack;
+    uint8_t*                           saved_stack; /* used part of the shared stack, while another coroutine runs on it */
+    size_t                             saved_size;
+    size_t                             saved_capacity;
+    size_t                             stack_peak; /* recorded when the stack is trimmed, with STACK_PAINTING */
     cco_await_callback                 await_ready;
     cco_await_callback                 await_on_suspend;
 };
 
-// Symbols included by arch.h, to be implemented on each processor:
-// #define CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS() /* implementation-defined, designed as a macro initializer */
-// CCO_PRIVATE always_inline size_t cco_get_cpu_context_size(const cco_architecture_specific_settings* arch_specific_settings);
-// CCO_PRIVATE always_inline void cco_prepare_coroutine(cco_coroutine* coroutine);
-// CCO_PRIVATE no_inline fastcall naked void cco_cswitch(cco_cpu_context* prev, cco_cpu_context* next);
-// CCO_PRIVATE cco_cpu_context* cco_main_context;
-// CCO_PRIVATE uint8_t* cco_current_stack_pointer();
-// CCO_PRIVATE uint8_t* cco_get_stack_pointer(const cco_coroutine*);
+// Symbols included by arch.h, to be implemented on each processor:
+// #define CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS() /* implementation-defined, designed as a macro initializer */
+// #define CCO_CPU_CONTEXT_ALIGNMENT /* alignment of the buffer allocated for the CPU context */
+// CCO_PRIVATE always_inline void cco_init_cpu_features(void);
+// CCO_PRIVATE always_inline size_t cco_get_cpu_context_size(const cco_architecture_specific_settings* arch_specific_settings);
+// CCO_PRIVATE always_inline void cco_init_cpu_context(cco_coroutine* coroutine);
+// CCO_PRIVATE always_inline void cco_prepare_coroutine(cco_coroutine* coroutine);
+// CCO_PRIVATE always_inline cco_cswitch_routine cco_select_cswitch(const cco_architecture_specific_settings* arch_specific_settings);
+// CCO_PRIVATE cco_cpu_context* cco_main_context;
+// CCO_PRIVATE uint8_t* cco_current_stack_pointer();
+// CCO_PRIVATE uint8_t* cco_get_stack_pointer(const cco_coroutine*);
+
+#define CCO_COROUTINE_IMPLEMENTATION
+#include "arch.h"
+
+_Static_assert(
+    sizeof(cco_coroutine) + _Alignof(cco_coroutine) - 1 <= CCO_COROUTINE_CONTROL_BLOCK_STORAGE_SIZE,
+    "CCO_COROUTINE_CONTROL_BLOCK_STORAGE_SIZE does not bound the size of cco_coroutine"
+);
+
+#if CCO_INLINE_API
+_Static_assert(
+    offsetof(cco_coroutine, return_value) == CCO_COROUTINE_RETURN_VALUE_OFFSET
+        && offsetof(cco_coroutine, state) == CCO_COROUTINE_STATE_OFFSET,
+    "the layout of cco_coroutine does not match the offsets read by cco/inline.h"
+);
+
+/** The main and the current coroutine are read by the functions of cco/inline.h. */
+#  define CCO_THREAD_STATE CCO_API_INTERNAL thread_local
+#else
+#  define CCO_THREAD_STATE CCO_PRIVATE thread_local
+#endif
+
+_Static_assert(
+    sizeof(_Atomic cco_coroutine_state) == sizeof(cco_coroutine_state), "cco/inline.h reads the state as a plain enum"
+);
+
+/**
+ * @brief Reads the state of @p coroutine, which may be written concurrently by the thread running it.
+ * 
+ * @details The transitions are release stores and the reads acquire loads, plain moves on x86 and single
+ * load-acquire/store-release instructions elsewhere, never fences. They make cco_coroutine_get_state() safe from any
+ * thread, but they do not publish the saved context, which is written after the state by the switch routine: the
+ * hand-over of a coroutine to another thread goes through cco_coroutine_release() and cco_coroutine_acquire().
+ */
+CCO_PRIVATE always_inline cco_coroutine_state
+cco_coroutine_load_state(const cco_coroutine* coroutine)
+{
+    return atomic_load_explicit(&coroutine->state, memory_order_acquire);
+}
+
+/**
+ * @brief Makes @p state the state of @p coroutine, see cco_coroutine_load_state().
+ */
+CCO_PRIVATE always_inline void
+cco_coroutine_set_state(cco_coroutine* coroutine, cco_coroutine_state state)
+{
+    atomic_store_explicit(&coroutine->state, state, memory_order_release);
+}
+
+#ifndef CCO_DEBUG
+#  define CCO_DEBUG 0
+#endif
+
+/** Whether the cco_*_fast() functions validate their arguments and context: only in debug builds of the library. */
+#ifndef CCO_FAST_PATH_CHECKS
+#  define CCO_FAST_PATH_CHECKS CCO_DEBUG
+#endif
+
+/** Internal flag of the coroutines created with cco_coroutine_create_in(), whose memory is not released. */
+#define CCO_COROUTINE_FLAG_EXTERNAL_STORAGE ((cco_coroutine_flags)(1u << 31))
+
+/** Flags a coroutine can be created with. */
+#define CCO_COROUTINE_FLAGS_VALID (CCO_COROUTINE_FLAG_GUARDED_STACK | CCO_COROUTINE_FLAG_TRIM_STACK)
+
+/** Flags CCO_COROUTINE_FLAGS_DEFAULT stands for. */
+#define CCO_COROUTINE_FLAGS_BUILD                                                                                                \
+  ((CCO_GUARDED_STACKS ? CCO_COROUTINE_FLAG_GUARDED_STACK : CCO_COROUTINE_FLAGS_NONE)                                            \
+   | (CCO_TRIM_STACKS ? CCO_COROUTINE_FLAG_TRIM_STACK : CCO_COROUTINE_FLAGS_NONE))
+
+struct cco_shared_stack {
+    uint8_t*             stack;
+    size_t               stack_size;
+    cco_coroutine*       owner; /* the coroutine whose frames are on the stack, NULL if none */
+    const cco_allocator* allocator;
+};
+
+/**
+ * @brief Makes the shared stack of @p next hold its frames, saving the ones of the coroutine holding it.
+ *
+ * @details Called before switching to @p next, from a context which is not running on that stack (see
+ * cco_shared_stack): the current owner, if it has live frames, is suspended and its stack pointer is saved in its
+ * context.
+ *
+ * @return cco_error CCO_ERROR_NO_MEMORY if the frames of the owner cannot be saved, in which case nothing changed.
+ */
+CCO_PRIVATE no_inline cco_error
+cco_shared_stack_switch(cco_coroutine* next)
+{
+    cco_shared_stack* shared = next->shared_stack;
+    uint8_t*          top    = shared->stack + shared->stack_size;
+    cco_coroutine*    owner  = shared->owner;
+    if(owner && cco_coroutine_load_state(owner) != CCO_COROUTINE_STATE_UNSCHEDULED) {
+        const uint8_t* sp   = cco_get_stack_pointer(owner);
+        const size_t   size = (size_t)(top - sp);
+        if(size > owner->saved_capacity) {
+            size_t capacity = owner->saved_capacity ? owner->saved_capacity : 256;
+            while(capacity < size) {
+                capacity *= 2;
+            }
+            uint8_t* saved_stack = (uint8_t*)cco_allocator_allocate(owner->allocator, capacity);
+            if(!saved_stack) {
+                return CCO_ERROR_NO_MEMORY;
+            }
+            cco_allocator_deallocate(owner->allocator, owner->saved_stack, owner->saved_capacity);
+            owner->saved_stack    = saved_stack;
+            owner->saved_capacity = capacity;
+        }
+        memcpy(owner->saved_stack, sp, size);
+        owner->saved_size = size;
+    }
+    // a coroutine being started has no frames yet
+    if(cco_coroutine_load_state(next) != CCO_COROUTINE_STATE_UNSCHEDULED) {
+        memcpy(top - next->saved_size, next->saved_stack, next->saved_size);
+    }
+    shared->owner = next;
+    return CCO_OK;
+}
+
+/**
+ * @brief Hands the shared stack of @p next over to it if another coroutine holds it, see cco_shared_stack_switch().
+ *
+ * @details Called before the switch to @p next is prepared, while it can still fail: it only moves frames between the
+ * stack and the save buffers, and it leaves everything as it was when it fails.
+ */
+CCO_PRIVATE always_inline cco_error
+cco_shared_stack_claim(cco_coroutine* next)
+{
+    return next->shared_stack && next->shared_stack->owner != next ? cco_shared_stack_switch(next) : CCO_OK;
+}
+
+/**
+ * @brief Suspends @p prev and resumes @p next.
+ * 
+ * @details Goes through the routine selected for @p prev when it was created: the coroutine being suspended saves,
+ * and later restores, its own optional registers. @p value is handed over in a register, and it is returned by the
+ * cco_cswitch() call @p next is suspended in, or dropped by the cco_cswitch_fast() one. If @p next runs on a shared
+ * stack, it already holds it, see cco_shared_stack_claim().
+ * 
+ * @param prev the coroutine to suspend
+ * @param next the coroutine to resume
+ * @param value the value to hand over to @p next
+ * @return void* the value handed over by the coroutine that resumes @p prev
+ */
+CCO_PRIVATE always_inline void*
+cco_cswitch(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value)
+{
+    return prev->cswitch(prev, next, value);
+}
+
+/**
+ * @brief Like cco_cswitch(), but returns CCO_OK once @p prev is resumed, for the cco_*_fast() functions.
+ * 
+ * @details The value handed over by the coroutine resuming @p prev is dropped. Not inlined, so that the fast functions
+ * end with a tail call to it and every fast switch calls the routine from the same site: the routine then returns where
+ * the processor predicts it does, and a fast switch pays no more mispredicted returns than a checked one.
+ * 
+ * @param prev the coroutine to suspend
+ * @param next the coroutine to resume
+ * @param value the value to hand over to @p next
+ * @return cco_error CCO_OK
+ */
+CCO_PRIVATE no_inline cco_error
+cco_cswitch_fast(cco_coroutine* restrict prev, cco_coroutine* restrict next, void* value)
+{
+    prev->cswitch(prev, next, value);
+    return CCO_OK;
+}
+
+/**
+ * @brief Whether a coroutine running on the stack of @p from can switch to @p to, see cco_shared_stack.
+ */
+CCO_PRIVATE always_inline bool
+cco_shared_stack_can_switch(const cco_coroutine* from, const cco_coroutine* to)
+{
+    return !to->shared_stack || to->shared_stack != from->shared_stack;
+}
+
+/**
+ * @brief Thread-local storage for the main coroutine.
+ * 
+ * @details The main coroutine is not exposed to the user, but it is used to store the context of the
+ * main function and to keep track of where the coroutine shall yield control to when it terminates.
+ * Also, its mere presence is useful to understand if the current context is the main context or not,
+ * by comparing the current coroutine with the main coroutine. This is actually how the library
+ * handles the main coroutine: data such as the return value, the stack/stack size and the state are
+ * not used, and the context is not used to switch to the main context, but only to store the context
+ * of the main function.
+ * 
+ * @note The main coroutine is thread local for the same reason why the main context is thread-local.
+ */
+CCO_THREAD_STATE cco_coroutine cco_main_coroutine initial_exec;
+
+/**
+ * @brief Thread-local pointer of the current coroutine.
+ * 
+ * @details The current coroutine is the coroutine that is currently running on the current thread.
+ * It is thread-local because each thread may run a different coroutine at the same time.
+ * The variable is loaded with the address of the main coroutine when the thread is set up (NULL until then, see
+ * cco_thread_init()), and it is updated every time a coroutine is switched to.
+ * 
+ * @note It does not need to be atomic because it is thread-local, nor volatile: the context switch routines are opaque
+ * calls, after which the compiler reloads it anyway. With INLINE_API, its initial-exec model makes reading it a single
+ * load.
+ */
+CCO_THREAD_STATE cco_coroutine* cco_current_coroutine initial_exec = NULL;
+
+/** Call handed over to the big stack of the thread, see cco_call_on_big_stack(). */
+typedef struct {
+    cco_big_stack_function function;
+    void*                  argument;
+    void*                  result;
+    cco_coroutine*         caller;
+} cco_big_stack_call;
+
+/** Coroutine running the calls on the big stack of the thread, created on the first one. */
+CCO_PRIVATE thread_local cco_coroutine* cco_big_stack;
+/** The call being run on the big stack, NULL when not on it: the current coroutine does not run then, nor switch. */
+CCO_PRIVATE thread_local cco_big_stack_call* cco_big_stack_current;
+
+/**
+ * @brief Whether @p coroutine was handed over with cco_coroutine_release() and not acquired since: no thread owns it, so
+ * none may switch to it nor destroy it.
+ */
+CCO_PRIVATE always_inline bool
+cco_coroutine_is_released(const cco_coroutine* coroutine)
+{
+    return atomic_load_explicit(&coroutine->released, memory_order_relaxed);
+}
+
+/**
+ * @brief Whether the calling thread may switch to @p to from its current coroutine: it is set up, not on the big stack,
+ * the current coroutine does not hold the stack @p to shares, and @p to is not released.
+ */
+CCO_PRIVATE always_inline bool
+cco_can_switch_to(const cco_coroutine* to)
+{
+    const cco_coroutine* current = cco_current_coroutine;
+    return current && !cco_big_stack_current && cco_shared_stack_can_switch(current, to)
+           && !cco_coroutine_is_released(to);
+}
+
+CCO_PRIVATE bool
+cco_await_true_callback(cco_coroutine* coroutine, void* argument)
+{
+    (void)coroutine;
+    (void)argument;
+    return true;
+}
+
+CCO_PRIVATE bool
+cco_await_false_callback(cco_coroutine* coroutine, void* argument)
+{
+    (void)coroutine;
+    (void)argument;
+    return false;
+}
+
+CCO_API_INTERNAL const cco_await_callback cco_await_not_ready = cco_await_false_callback;
+
+CCO_API_INTERNAL const cco_await_callback cco_await_ready = cco_await_true_callback;
+
+/**
+ * @brief Sets up the main coroutine of the calling thread, and makes it the current one.
+ */
+CCO_PRIVATE no_inline void
+cco_thread_setup(void)
+{
+    const cco_architecture_specific_settings* settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
+    for(int i = 0; i != sizeof(cco_architecture_specific_settings); ++i) {
+        ((uint8_t*)&cco_main_coroutine.settings)[i] = ((uint8_t*)settings)[i];
+    }
+    cco_main_coroutine.context = (cco_cpu_context*)cco_main_context;
+    cco_main_coroutine.cswitch = cco_select_cswitch(settings);
+    cco_coroutine_set_state(&cco_main_coroutine, CCO_COROUTINE_STATE_RUNNING);
+    cco_current_coroutine      = &cco_main_coroutine;
+    cco_init_cpu_context(&cco_main_coroutine);
+}
+
+/**
+ * @brief Sets up the calling thread if it is its first use of the library.
+ * 
+ * @details Called where a coroutine becomes reachable from the thread, i.e. where coroutines are created or acquired and
+ * by cco_scheduler_run(), never on the switches themselves: a thread which runs coroutines created elsewhere without
+ * acquiring them calls cco_thread_init() first, or its switches fail with CCO_ERROR_INVALID_CONTEXT.
+ */
+CCO_PRIVATE always_inline void
+cco_thread_setup_once(void)
+{
+    if(!cco_current_coroutine) {
+        cco_thread_setup();
+    }
+}
+
+/**
+ * @brief Constructor function of the library, called before main() and used to initialize the global variables.
+ * 
+ * @details It also sets up the thread which loads the library, the other ones are set up on their first use.
+ */
+CCO_PRIVATE void ctor
+cco_init(void)
+{
+    cco_init_cpu_features();
+    cco_thread_setup();
+}
+
+CCO_API_INTERNAL void
+cco_thread_init(void)
+{
+    cco_thread_setup_once();
+    *cco_errno_location() = CCO_OK;
+}
+
+/**
+ * @brief Offsets of the parts of a coroutine within its memory block.
+ *
+ * @details A coroutine is allocated as a single block, aligned to CCO_CPU_CONTEXT_ALIGNMENT: the stack comes first, and
+ * its top is followed by the CPU context and by the control block. The data touched by every switch then sits in the
+ * same few cache lines and pages as the top of the stack, and a coroutine costs one allocation. A stack overflow runs
+ * away from the control block rather than into it.
+ */
+typedef struct cco_coroutine_layout {
+    size_t context_offset;   /**< Offset of the CPU context, right above the stack. */
+    size_t context_size;     /**< Size of the CPU context. */
+    size_t coroutine_offset; /**< Offset of the control block, right above the CPU context. */
+    size_t size;             /**< Size of the whole block. */
+} cco_coroutine_layout;
+
+#if CCO_STACK_PAINTING
+/** Value the stacks are filled with at creation, see cco_coroutine_get_stack_peak(). */
+#  define CCO_STACK_PAINT ((uintptr_t)(UINTPTR_MAX / 0xff * 0xcc))
+
+/** Number of words compared at once when scanning, so that the compiler can use vector compares. */
+#  define CCO_STACK_SCAN_WORDS 8
+
+CCO_PRIVATE void
+cco_paint_stack(uint8_t* stack, size_t stack_size)
+{
+    uintptr_t*       word = (uintptr_t*)stack;
+    uintptr_t* const end  = word + stack_size / sizeof(uintptr_t);
+    while(word != end) {
+        *word++ = CCO_STACK_PAINT;
+    }
+}
+
+/**
+ * @brief Returns the offset of the first word of @p stack that differs from the paint, @p stack_size if none does.
+ *
+ * @details Zero words count as painted, since the pages discarded by cco_coroutine_trim_stack() read as zero.
+ */
+CCO_PRIVATE size_t
+cco_scan_stack(const uint8_t* stack, size_t stack_size)
+{
+    const uintptr_t*       word   = (const uintptr_t*)stack;
+    const size_t           words  = stack_size / sizeof(uintptr_t);
+    const uintptr_t* const blocks = word + words / CCO_STACK_SCAN_WORDS * CCO_STACK_SCAN_WORDS;
+    // whole blocks first, with no branch inside a block
+    while(word != blocks) {
+        uintptr_t diff = 0;
+        for(int i = 0; i != CCO_STACK_SCAN_WORDS; ++i) {
+            diff |= (uintptr_t)(word[i] != CCO_STACK_PAINT && word[i] != 0);
+        }
+        if(diff) {
+            break;
+        }
+        word += CCO_STACK_SCAN_WORDS;
+    }
+    const uintptr_t* const end = (const uintptr_t*)stack + words;
+    while(word != end && (*word == CCO_STACK_PAINT || *word == 0)) {
+        ++word;
+    }
+    return word != end ? (size_t)((const uint8_t*)word - stack) : stack_size;
+}
+#endif
+
+/**
+ * @brief Discards the whole pages of the stack of @p coroutine below @p sp, see cco_coroutine_trim_stack().
+ *
+ * @return size_t the number of bytes discarded
+ */
+CCO_PRIVATE size_t
+cco_trim_stack_below(cco_coroutine* coroutine, const uint8_t* sp)
+{
+    const uintptr_t page_size = cco_page_size();
+    const uintptr_t begin     = ((uintptr_t)coroutine->stack + page_size - 1) & ~(page_size - 1);
+    const uintptr_t end       = (uintptr_t)sp & ~(page_size - 1);
+    if(end <= begin) {
+        return 0;
+    }
+#if CCO_STACK_PAINTING
+    const size_t peak = coroutine->stack_size - cco_scan_stack(coroutine->stack, coroutine->stack_size);
+    if(peak > coroutine->stack_peak) {
+        coroutine->stack_peak = peak;
+    }
+#endif
+    return cco_discard_pages((void*)begin, end - begin) ? end - begin : 0;
+}
+
+/**
+ * @brief Computes the layout of a coroutine with a stack of @p stack_size bytes and the given settings.
+ *
+ * @return bool false if the block would not fit in a size_t
+ */
+CCO_PRIVATE always_inline bool
+cco_coroutine_get_layout(size_t stack_size, const cco_architecture_specific_settings* settings, cco_coroutine_layout* layout)
+{
+    const size_t context_alignment   = CCO_CPU_CONTEXT_ALIGNMENT;
+    const size_t coroutine_alignment = _Alignof(cco_coroutine);
+    layout->context_size             = cco_get_cpu_context_size(settings);
+    const size_t overhead = context_alignment + layout->context_size + coroutine_alignment + sizeof(cco_coroutine);
+    if(stack_size > SIZE_MAX - overhead) {
+        layout->context_offset = layout->coroutine_offset = layout->size = 0;
+        return false;
+    }
+    layout->context_offset   = (stack_size + context_alignment - 1) & ~(context_alignment - 1);
+    layout->coroutine_offset = (layout->context_offset + layout->context_size + coroutine_alignment - 1) & ~(coroutine_alignment - 1);
+    layout->size             = layout->coroutine_offset + sizeof(cco_coroutine);
+    return true;
+}
+
+/**
+ * @brief Size of the mapping of a guarded coroutine, guard page excluded.
+ */
+CCO_PRIVATE always_inline size_t
+cco_coroutine_get_mapping_size(const cco_coroutine_layout* layout)
+{
+    const size_t page_size = cco_page_size();
+    return (layout->size + page_size - 1) & ~(page_size - 1);
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_coroutine_create(size_t stack_size, const cco_architecture_specific_settings* settings)
+{
+    return cco_coroutine_create_with_flags(stack_size, settings, CCO_COROUTINE_FLAGS_DEFAULT);
+}
+
+/**
+ * @brief Creates a coroutine with the memory of @p allocator, or of the default allocator if NULL.
+ */
+CCO_PRIVATE cco_coroutine*
+cco_coroutine_create_from(
+    const cco_allocator* allocator, size_t stack_size, const cco_architecture_specific_settings* settings, cco_coroutine_flags flags
+)
+{
+    cco_thread_setup_once();
+    if(flags == CCO_COROUTINE_FLAGS_DEFAULT) {
+        flags = CCO_COROUTINE_FLAGS_BUILD;
+    }
+    if(stack_size < CCO_MIN_STACK_SIZE || (flags & ~CCO_COROUTINE_FLAGS_VALID)) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    if(!settings) {
+        settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
+    }
+
+    cco_coroutine_layout layout;
+    uint8_t*             stack = NULL;
+    uint8_t*             block = NULL;
+    if(allocator) {
+        // the stack apart, and the context first in a block without a stack
+        cco_coroutine_get_layout(0, settings, &layout);
+        if((stack = (uint8_t*)allocator->allocate_stack(allocator->user_data, stack_size)) != NULL) {
+            block = (uint8_t*)allocator->allocate_context(allocator->user_data, layout.size, CCO_CPU_CONTEXT_ALIGNMENT);
+            if(block) {
+                memset(block, 0, layout.size);
+            }
+            else {
+                allocator->deallocate_stack(allocator->user_data, stack, stack_size);
+            }
+        }
+    }
+    else if(cco_coroutine_get_layout(stack_size, settings, &layout)) {
+        if(flags & CCO_COROUTINE_FLAG_GUARDED_STACK) {
+            // page-aligned, hence aligned to CCO_CPU_CONTEXT_ALIGNMENT, and already zeroed
+            block = (uint8_t*)cco_map_guarded(cco_coroutine_get_mapping_size(&layout), cco_page_size());
+        }
+        else if((block = (uint8_t*)cco_aligned_alloc(layout.size, CCO_CPU_CONTEXT_ALIGNMENT)) != NULL) {
+            memset(block + layout.context_offset, 0, layout.size - layout.context_offset);
+        }
+    }
+    if(!block) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    if(!allocator) {
+        stack = block;
+    }
+
+#if CCO_STACK_PAINTING
+    cco_paint_stack(stack, stack_size);
+#endif
+    cco_coroutine* out = (cco_coroutine*)(block + layout.coroutine_offset);
+    out->context    = (cco_cpu_context*)(block + layout.context_offset);
+    out->stack      = stack;
+    out->stack_size = stack_size;
+    out->flags      = flags;
+    out->allocator  = allocator;
+    for(size_t i = 0; i < sizeof(cco_architecture_specific_settings); ++i) {
+        ((uint8_t*)&out->settings)[i] = ((uint8_t*)settings)[i];
+    }
+    out->cswitch = cco_select_cswitch(settings);
+    cco_init_cpu_context(out);
+    cco_coroutine_set_state(out, CCO_COROUTINE_STATE_UNSCHEDULED);
+    *cco_errno_location() = CCO_OK;
+    return out;
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_coroutine_create_with_flags(size_t stack_size, const cco_architecture_specific_settings* settings, cco_coroutine_flags flags)
+{
+    return cco_coroutine_create_from(cco_get_allocator(), stack_size, settings, flags);
+}
+
+CCO_API_INTERNAL cco_shared_stack*
+cco_shared_stack_create(size_t stack_size)
+{
+    const size_t page_size = cco_page_size();
+    if(stack_size == 0 || stack_size > SIZE_MAX - page_size) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    stack_size                     = (stack_size + page_size - 1) & ~(page_size - 1);
+    const cco_allocator* allocator = cco_get_allocator();
+    cco_shared_stack*    shared    = (cco_shared_stack*)cco_allocator_allocate(allocator, sizeof(cco_shared_stack));
+    if(shared) {
+        shared->stack = allocator ? (uint8_t*)allocator->allocate_stack(allocator->user_data, stack_size)
+                                  : (uint8_t*)cco_map_guarded(stack_size, page_size);
+        if(!shared->stack) {
+            cco_allocator_deallocate(allocator, shared, sizeof(cco_shared_stack));
+            shared = NULL;
+        }
+    }
+    if(!shared) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+#if CCO_STACK_PAINTING
+    cco_paint_stack(shared->stack, stack_size);
+#endif
+    shared->stack_size    = stack_size;
+    shared->owner         = NULL;
+    shared->allocator     = allocator;
+    *cco_errno_location() = CCO_OK;
+    return shared;
+}
+
+CCO_API_INTERNAL void
+cco_shared_stack_destroy(cco_shared_stack* stack)
+{
+    if(stack) {
+        const cco_allocator* allocator = stack->allocator;
+        if(allocator) {
+            allocator->deallocate_stack(allocator->user_data, stack->stack, stack->stack_size);
+        }
+        else {
+            cco_unmap_guarded(stack->stack, stack->stack_size, cco_page_size());
+        }
+        cco_allocator_deallocate(allocator, stack, sizeof(cco_shared_stack));
+        *cco_errno_location() = CCO_OK;
+    }
+    else {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_coroutine_create_shared(cco_shared_stack* stack, const cco_architecture_specific_settings* settings)
+{
+    cco_thread_setup_once();
+    if(!stack) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    if(!settings) {
+        settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
+    }
+
+    // a block without a stack: the context comes first
+    const cco_allocator* allocator = cco_get_allocator();
+    cco_coroutine_layout layout;
+    cco_coroutine_get_layout(0, settings, &layout);
+    uint8_t* block = allocator ? (uint8_t*)allocator->allocate_context(allocator->user_data, layout.size, CCO_CPU_CONTEXT_ALIGNMENT)
+                               : (uint8_t*)cco_aligned_alloc(layout.size, CCO_CPU_CONTEXT_ALIGNMENT);
+    if(!block) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    memset(block, 0, layout.size);
+
+    cco_coroutine* out = (cco_coroutine*)(block + layout.coroutine_offset);
+    out->context      = (cco_cpu_context*)block;
+    out->stack        = stack->stack;
+    out->stack_size   = stack->stack_size;
+    out->shared_stack = stack;
+    out->allocator    = allocator;
+    out->flags        = CCO_COROUTINE_FLAGS_BUILD & CCO_COROUTINE_FLAG_TRIM_STACK;
+    memcpy(&out->settings, settings, sizeof(cco_architecture_specific_settings));
+    out->cswitch = cco_select_cswitch(settings);
+    cco_init_cpu_context(out);
+    cco_coroutine_set_state(out, CCO_COROUTINE_STATE_UNSCHEDULED);
+    *cco_errno_location() = CCO_OK;
+    return out;
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_coroutine_create_in(void* buffer, size_t size, const cco_architecture_specific_settings* settings)
+{
+    cco_thread_setup_once();
+    if(!settings) {
+        settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
+    }
+    // the control block at the end of the buffer, the context right below it, and the stack below the context
+    const uintptr_t begin        = (uintptr_t)buffer;
+    const size_t    context_size = cco_get_cpu_context_size(settings);
+    const size_t    reserved     = context_size + CCO_CPU_CONTEXT_ALIGNMENT + sizeof(cco_coroutine) + _Alignof(cco_coroutine);
+    // whatever the alignment of the buffer, the stack is then at least CCO_MIN_STACK_SIZE bytes
+    if(!buffer || size < reserved + CCO_MIN_STACK_SIZE || begin > UINTPTR_MAX - size) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    const uintptr_t coroutine = (begin + size - sizeof(cco_coroutine)) & ~(uintptr_t)(_Alignof(cco_coroutine) - 1);
+    const uintptr_t context   = (coroutine - context_size) & ~(uintptr_t)(CCO_CPU_CONTEXT_ALIGNMENT - 1);
+    memset((void*)context, 0, begin + size - context);
+
+#if CCO_STACK_PAINTING
+    cco_paint_stack((uint8_t*)buffer, context - begin);
+#endif
+    cco_coroutine* out = (cco_coroutine*)coroutine;
+    out->context       = (cco_cpu_context*)context;
+    out->stack         = (uint8_t*)buffer;
+    out->stack_size    = context - begin;
+    out->flags         = CCO_COROUTINE_FLAG_EXTERNAL_STORAGE;
+    memcpy(&out->settings, settings, sizeof(cco_architecture_specific_settings));
+    out->cswitch = cco_select_cswitch(settings);
+    cco_init_cpu_context(out);
+    cco_coroutine_set_state(out, CCO_COROUTINE_STATE_UNSCHEDULED);
+    *cco_errno_location() = CCO_OK;
+    return out;
+}
+
+/**
+ * @brief Gives the memory of @p coroutine back, however it was obtained.
+ */
+CCO_PRIVATE void
+cco_coroutine_free(cco_coroutine* coroutine)
+{
+    const cco_allocator* allocator = coroutine->allocator;
+    if(coroutine->flags & CCO_COROUTINE_FLAG_EXTERNAL_STORAGE) {
+        // the buffer belongs to the caller
+    }
+    else if(allocator || coroutine->shared_stack) {
+        // the block starts with the context, there is no stack in it
+        cco_coroutine_layout layout;
+        cco_coroutine_get_layout(0, &coroutine->settings, &layout);
+        if(coroutine->shared_stack) {
+            if(coroutine->shared_stack->owner == coroutine) {
+                coroutine->shared_stack->owner = NULL;
+            }
+            cco_allocator_deallocate(allocator, coroutine->saved_stack, coroutine->saved_capacity);
+        }
+        else {
+            allocator->deallocate_stack(allocator->user_data, coroutine->stack, coroutine->stack_size);
+        }
+        if(allocator) {
+            allocator->deallocate_context(allocator->user_data, coroutine->context, layout.size);
+        }
+        else {
+            cco_aligned_free(coroutine->context);
+        }
+    }
+    else if(coroutine->flags & CCO_COROUTINE_FLAG_GUARDED_STACK) {
+        cco_coroutine_layout layout;
+        cco_coroutine_get_layout(coroutine->stack_size, &coroutine->settings, &layout);
+        cco_unmap_guarded(coroutine->stack, cco_coroutine_get_mapping_size(&layout), cco_page_size());
+    }
+    else {
+        cco_aligned_free(coroutine->stack);
+    }
+}
+
+CCO_API_INTERNAL void
+cco_coroutine_destroy(cco_coroutine* coroutine)
+{
+    if(coroutine) {
+        if(coroutine != &cco_main_coroutine) {
+            // cco_cpu_context return_context;
+            // memcpy(&return_context, coroutine->context, sizeof(cco_cpu_context));
+            // cco_free(coroutine->stack);
+            // TODO this will be a problem. We're pulling the rug out from under our feet:
+            // to perform a context switch we are using the stack of the coroutine we're destroying.
+            // We need to find a way to switch to the calling context without using the stack of the
+            // coroutine we're destroying.
+            // For now I will just add a check to not destroy the current coroutine.
+            if(coroutine == cco_current_coroutine || cco_coroutine_is_released(coroutine)) {
+                *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+                return;
+            }
+            // still linked in the ready queue of a scheduler, which would run it after it is freed
+            if(coroutine->scheduler) {
+                *cco_errno_location() = CCO_ERROR_SCHEDULED;
+                return;
+            }
+            cco_coroutine_free(coroutine);
+            *cco_errno_location() = CCO_OK;
+        }
+        else {
+            *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    else {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+struct cco_pool {
+    const cco_allocator*               allocator;
+    cco_architecture_specific_settings settings;
+    cco_coroutine_flags                flags;
+    size_t                             max_cached;
+    size_t                             cached[CCO_POOL_SIZE_CLASSES];
+    cco_coroutine*                     free_lists[CCO_POOL_SIZE_CLASSES];
+};
+
+/**
+ * @brief Size class of the coroutines with a stack of @p stack_size bytes, CCO_POOL_SIZE_CLASSES if there is none.
+ */
+CCO_PRIVATE always_inline unsigned int
+cco_pool_get_size_class(size_t stack_size)
+{
+    unsigned int size_class = 0;
+    while(size_class != CCO_POOL_SIZE_CLASSES && CCO_POOL_CLASS_STACK_SIZE(size_class) < stack_size) {
+        ++size_class;
+    }
+    return size_class;
+}
+
+CCO_API_INTERNAL cco_pool*
+cco_pool_create(const cco_architecture_specific_settings* settings, cco_coroutine_flags flags, size_t max_cached)
+{
+    if(flags == CCO_COROUTINE_FLAGS_DEFAULT) {
+        flags = CCO_COROUTINE_FLAGS_BUILD;
+    }
+    if(flags & ~CCO_COROUTINE_FLAGS_VALID) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    if(!settings) {
+        settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
+    }
+    const cco_allocator* allocator = cco_get_allocator();
+    cco_pool*            pool      = (cco_pool*)cco_allocator_allocate(allocator, sizeof(cco_pool));
+    if(!pool) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    memset(pool, 0, sizeof(cco_pool));
+    pool->allocator = allocator;
+    memcpy(&pool->settings, settings, sizeof(cco_architecture_specific_settings));
+    pool->flags           = flags;
+    pool->max_cached      = max_cached;
+    *cco_errno_location() = CCO_OK;
+    return pool;
+}
+
+CCO_API_INTERNAL void
+cco_pool_destroy(cco_pool* pool)
+{
+    if(pool) {
+        cco_pool_trim(pool, 0);
+        cco_allocator_deallocate(pool->allocator, pool, sizeof(cco_pool));
+        *cco_errno_location() = CCO_OK;
+    }
+    else {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_pool_acquire(cco_pool* pool, size_t stack_size)
+{
+    if(!pool || stack_size == 0) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    const unsigned int size_class = cco_pool_get_size_class(stack_size);
+    if(size_class == CCO_POOL_SIZE_CLASSES) {
+        return cco_coroutine_create_from(pool->allocator, stack_size, &pool->settings, pool->flags);
+    }
+    cco_coroutine* coroutine = pool->free_lists[size_class];
+    if(coroutine) {
+        pool->free_lists[size_class] = coroutine->next;
+        --pool->cached[size_class];
+        *cco_errno_location() = CCO_OK;
+        return coroutine;
+    }
+    return cco_coroutine_create_from(pool->allocator, CCO_POOL_CLASS_STACK_SIZE(size_class), &pool->settings, pool->flags);
+}
+
+/**
+ * @brief Clears what the runs of @p coroutine left behind, so that it is cached as if it had just been created.
+ */
+CCO_PRIVATE void
+cco_pool_reset(cco_coroutine* coroutine)
+{
+#if CCO_STACK_PAINTING
+    // only the part of the stack painted over since the coroutine was created or last reset
+    const size_t painted = cco_scan_stack(coroutine->stack, coroutine->stack_size);
+    cco_paint_stack(coroutine->stack + painted, coroutine->stack_size - painted);
+#endif
+    coroutine->return_value     = NULL;
+    coroutine->caller           = NULL;
+    coroutine->callback         = NULL;
+    coroutine->arg              = NULL;
+    coroutine->spawned          = false;
+    coroutine->scheduler        = NULL;
+    coroutine->saved_size       = 0;
+    coroutine->stack_peak       = 0;
+    coroutine->await_ready      = NULL;
+    coroutine->await_on_suspend = NULL;
+    cco_coroutine_set_state(coroutine, CCO_COROUTINE_STATE_UNSCHEDULED);
+}
+
+CCO_API_INTERNAL void
+cco_pool_release(cco_pool* pool, cco_coroutine* coroutine)
+{
+    if(!pool || !coroutine || coroutine == &cco_main_coroutine) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return;
+    }
+    if(coroutine == cco_current_coroutine || cco_coroutine_is_released(coroutine)) {
+        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+        return;
+    }
+    // its next member links it in the ready queue of a scheduler, and cannot link it in a free list as well
+    if(coroutine->scheduler) {
+        *cco_errno_location() = CCO_ERROR_SCHEDULED;
+        return;
+    }
+    const unsigned int size_class = cco_pool_get_size_class(coroutine->stack_size);
+    if(coroutine->shared_stack || size_class == CCO_POOL_SIZE_CLASSES || CCO_POOL_CLASS_STACK_SIZE(size_class) != coroutine->stack_size
+       || pool->cached[size_class] >= pool->max_cached || coroutine->flags != pool->flags || coroutine->allocator != pool->allocator
+       || memcmp(&coroutine->settings, &pool->settings, sizeof(cco_architecture_specific_settings)) != 0) {
+        cco_coroutine_free(coroutine);
+    }
+    else {
+        cco_pool_reset(coroutine);
+        coroutine->next              = pool->free_lists[size_class];
+        pool->free_lists[size_class] = coroutine;
+        ++pool->cached[size_class];
+    }
+    *cco_errno_location() = CCO_OK;
+}
+
+CCO_API_INTERNAL size_t
+cco_pool_trim(cco_pool* pool, size_t keep)
+{
+    if(!pool) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    size_t destroyed = 0;
+    for(unsigned int size_class = 0; size_class != CCO_POOL_SIZE_CLASSES; ++size_class) {
+        while(pool->cached[size_class] > keep) {
+            cco_coroutine* coroutine     = pool->free_lists[size_class];
+            pool->free_lists[size_class] = coroutine->next;
+            --pool->cached[size_class];
+            cco_coroutine_free(coroutine);
+            ++destroyed;
+        }
+    }
+    *cco_errno_location() = CCO_OK;
+    return destroyed;
+}
+
+CCO_PRIVATE no_inline void
+cco_coroutine_entry_point(cco_coroutine* coroutine)
+{
+    cco_coroutine_set_state(coroutine, CCO_COROUTINE_STATE_RUNNING);
+    coroutine->callback(coroutine->arg);
+    // cco_return() only fails here while the frames holding the shared stack of the caller cannot be saved
+    for(;;) {
+        cco_return(NULL);
+    }
+}
+
+/**
+ * @brief Validates the arguments of cco_coroutine_start().
+ */
+CCO_PRIVATE always_inline cco_error
+cco_coroutine_start_check(const cco_coroutine* coroutine, cco_coroutine_callback callback)
+{
+    if(!coroutine) {
+        return CCO_ERROR_INVALID_ARGUMENT;
+    }
+    if(cco_coroutine_load_state(coroutine) != CCO_COROUTINE_STATE_UNSCHEDULED) {
+        return CCO_ERROR_SCHEDULED;
+    }
+    if(!cco_can_switch_to(coroutine)) {
+        return CCO_ERROR_INVALID_CONTEXT;
+    }
+    return callback ? CCO_OK : CCO_ERROR_INVALID_ARGUMENT;
+}
+
+/**
+ * @brief Starts @p coroutine, whose arguments are valid, and returns once it gives control back.
+ */
+CCO_PRIVATE always_inline void
+cco_coroutine_start_switch(cco_coroutine* coroutine, cco_coroutine_callback callback, void* arg)
+{
+    coroutine->callback         = callback;
+    coroutine->arg              = arg;
+    coroutine->caller           = cco_current_coroutine;
+    coroutine->await_ready      = cco_await_not_ready;
+    coroutine->await_on_suspend = NULL;
+    cco_prepare_coroutine(coroutine);
+    cco_current_coroutine = coroutine;
+    cco_cswitch(coroutine->caller, coroutine, NULL);
+    /*
+        Notice that after cco_cswitch we will return in the context of the coroutine, hence we will
+        come back to this context only when the coroutine will yield or return (explicitly or implicitly).
+    */
+    cco_current_coroutine = coroutine->caller;
+}
+
+CCO_API_INTERNAL bool
+cco_coroutine_start(cco_coroutine* coroutine, cco_coroutine_callback callback, void* arg)
+{
+    cco_error error = cco_coroutine_start_check(coroutine, callback);
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(coroutine);
+    }
+    *cco_errno_location() = error;
+    if(error != CCO_OK) {
+        return false;
+    }
+    cco_coroutine_start_switch(coroutine, callback, arg);
+    return true;
+}
+
+CCO_API_INTERNAL cco_error
+cco_coroutine_start_fast(cco_coroutine* coroutine, cco_coroutine_callback callback, void* arg)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_coroutine_start_check(coroutine, callback);
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(coroutine);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    cco_coroutine_start_switch(coroutine, callback, arg);
+    return CCO_OK;
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_this_coroutine(void)
+{
+    *cco_errno_location() = CCO_OK;
+    return cco_current_coroutine != &cco_main_coroutine ? cco_current_coroutine : NULL;
+}
+
+CCO_API_INTERNAL cco_coroutine*
+cco_this_coroutine_fast(void)
+{
+    return cco_current_coroutine != &cco_main_coroutine ? cco_current_coroutine : NULL;
+}
+
+/**
+ * @brief Validates the context of the functions which shall be called from a coroutine.
+ */
+CCO_PRIVATE always_inline cco_error
+cco_coroutine_context_check(void)
+{
+    const cco_coroutine* current = cco_current_coroutine;
+    return !current || current == &cco_main_coroutine || cco_big_stack_current ? CCO_ERROR_INVALID_CONTEXT : CCO_OK;
+}
+
+/**
+ * @brief Unschedules the current coroutine, storing @p value, and makes its caller the current one.
+ * 
+ * @return cco_coroutine* The coroutine being unscheduled, which shall switch to its caller.
+ */
+CCO_PRIVATE always_inline cco_coroutine*
+cco_return_prepare(void* value)
+{
+    cco_coroutine* current = cco_current_coroutine;
+    if(current->flags & CCO_COROUTINE_FLAG_TRIM_STACK) {
+        // nothing below this frame is needed any more, but the page below it hosts the frames of the system call
+        cco_trim_stack_below(current, cco_current_stack_pointer() - cco_page_size());
+    }
+    current->return_value = value;
+    cco_current_coroutine = current->caller;
+    cco_coroutine_set_state(current, CCO_COROUTINE_STATE_UNSCHEDULED);
+    return current;
+}
+
+CCO_API_INTERNAL void
+cco_return(void* value)
+{
+    cco_error error = cco_coroutine_context_check();
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(cco_current_coroutine->caller);
+    }
+    *cco_errno_location() = error;
+    if(error == CCO_OK) {
+        cco_coroutine* current = cco_return_prepare(value);
+        cco_cswitch(current, current->caller, value);
+    }
+}
+
+CCO_API_INTERNAL cco_error
+cco_return_fast(void* value)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_coroutine_context_check();
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(cco_current_coroutine->caller);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    cco_coroutine* current = cco_return_prepare(value);
+    return cco_cswitch_fast(current, current->caller, value);
+}
+
+/**
+ * @brief Suspends the current coroutine and makes its caller the current one.
+ * 
+ * @return cco_coroutine* The coroutine being suspended, which shall switch to its caller.
+ */
+CCO_PRIVATE always_inline cco_coroutine*
+cco_suspend_prepare(void)
+{
+    cco_coroutine* current = cco_current_coroutine;
+    cco_current_coroutine  = current->caller;
+    cco_coroutine_set_state(current, CCO_COROUTINE_STATE_SUSPENDED);
+    return current;
+}
+
+CCO_API_INTERNAL void
+cco_suspend(void)
+{
+    cco_error error = cco_coroutine_context_check();
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(cco_current_coroutine->caller);
+    }
+    *cco_errno_location() = error;
+    if(error == CCO_OK) {
+        cco_coroutine* current = cco_suspend_prepare();
+        cco_cswitch(current, current->caller, NULL);
+    }
+}
+
+CCO_API_INTERNAL cco_error
+cco_suspend_fast(void)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_coroutine_context_check();
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(cco_current_coroutine->caller);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    cco_coroutine* current = cco_suspend_prepare();
+    return cco_cswitch_fast(current, current->caller, NULL);
+}
+
+/**
+ * @brief Validates the arguments of cco_resume() and cco_resume_with().
+ */
+CCO_PRIVATE always_inline cco_error
+cco_resume_check(const cco_coroutine* coroutine)
+{
+    if(!coroutine) {
+        return CCO_ERROR_INVALID_ARGUMENT;
+    }
+    if(coroutine == &cco_main_coroutine || !cco_can_switch_to(coroutine)) {
+        return CCO_ERROR_INVALID_CONTEXT;
+    }
+    return cco_coroutine_load_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED ? CCO_OK : CCO_ERROR_NOT_SUSPENDED;
+}
+
+/**
+ * @brief Makes @p coroutine, whose arguments are valid, the current one.
+ * 
+ * @return cco_coroutine* The coroutine being suspended, which shall switch to @p coroutine.
+ */
+CCO_PRIVATE always_inline cco_coroutine*
+cco_resume_prepare(cco_coroutine* coroutine)
+{
+    coroutine->caller     = cco_current_coroutine;
+    cco_current_coroutine = coroutine;
+    cco_coroutine_set_state(coroutine, CCO_COROUTINE_STATE_RUNNING);
+    return coroutine->caller;
+}
+
+CCO_API_INTERNAL void
+cco_resume(cco_coroutine* coroutine)
+{
+    cco_error error = cco_resume_check(coroutine);
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(coroutine);
+    }
+    *cco_errno_location() = error;
+    if(error == CCO_OK) {
+        cco_cswitch(cco_resume_prepare(coroutine), coroutine, NULL);
+    }
+}
+
+CCO_API_INTERNAL cco_error
+cco_resume_fast(cco_coroutine* coroutine)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_resume_check(coroutine);
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(coroutine);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    return cco_cswitch_fast(cco_resume_prepare(coroutine), coroutine, NULL);
+}
+
+CCO_API_INTERNAL void*
+cco_resume_with(cco_coroutine* coroutine, void* value)
+{
+    cco_error error = cco_resume_check(coroutine);
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(coroutine);
+    }
+    if(error != CCO_OK) {
+        *cco_errno_location() = error;
+        return NULL;
+    }
+    return cco_cswitch(cco_resume_prepare(coroutine), coroutine, value);
+}
+
+CCO_API_INTERNAL void
+cco_yield(void* value)
+{
+    cco_error error = cco_coroutine_context_check();
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(cco_current_coroutine->caller);
+    }
+    *cco_errno_location() = error;
+    if(error == CCO_OK) {
+        cco_coroutine* current = cco_suspend_prepare();
+        current->return_value  = value;
+        cco_cswitch(current, current->caller, value);
+    }
+}
 
-#define CCO_COROUTINE_IMPLEMENTATION
-#include "arch.h"
+CCO_API_INTERNAL cco_error
+cco_yield_fast(void* value)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_coroutine_context_check();
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(cco_current_coroutine->caller);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    cco_coroutine* current = cco_suspend_prepare();
+    current->return_value  = value;
+    return cco_cswitch_fast(current, current->caller, value);
+}
+
+CCO_API_INTERNAL void*
+cco_yield_with(void* value)
+{
+    cco_error error = cco_coroutine_context_check();
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(cco_current_coroutine->caller);
+    }
+    if(error != CCO_OK) {
+        *cco_errno_location() = error;
+        return NULL;
+    }
+    cco_coroutine* current = cco_suspend_prepare();
+    return cco_cswitch(current, current->caller, value);
+}
 
 /**
- * @brief Thread-local storage for the main coroutine.
- * 
- * @details The main coroutine is not exposed to the user, but it is used to store the context of the
- * main function and to keep track of where the coroutine shall yield control to when it terminates.
- * Also, its mere presence is useful to understand if the current context is the main context or not,
- * by comparing the current coroutine with the main coroutine. This is actually how the library
- * handles the main coroutine: data such as the return value, the stack/stack size and the state are
- * not used, and the context is not used to switch to the main context, but only to store the context
- * of the main function.
- * 
- * @note The main coroutine is thread local for the same reason why the main context is thread-local.
+ * @brief Validates the context and the arguments of cco_transfer().
  */
-CCO_PRIVATE thread_local cco_coroutine cco_main_coroutine;
+CCO_PRIVATE always_inline cco_error
+cco_transfer_check(const cco_coroutine* next)
+{
+    const cco_coroutine* current = cco_current_coroutine;
+    if(!current || current == &cco_main_coroutine || cco_big_stack_current) {
+        return CCO_ERROR_INVALID_CONTEXT;
+    }
+    if(!next || next == &cco_main_coroutine || next == current) {
+        return CCO_ERROR_INVALID_ARGUMENT;
+    }
+    if(cco_coroutine_load_state(next) != CCO_COROUTINE_STATE_SUSPENDED) {
+        return CCO_ERROR_NOT_SUSPENDED;
+    }
+    if(!cco_shared_stack_can_switch(current, next) || !cco_shared_stack_can_switch(current->caller, next)
+       || cco_coroutine_is_released(next)) {
+        return CCO_ERROR_INVALID_CONTEXT;
+    }
+    return CCO_OK;
+}
 
 /**
- * @brief Thread-local pointer of the current coroutine.
- * 
- * @details The current coroutine is the coroutine that is currently running on the current thread.
- * It is thread-local because each thread may run a different coroutine at the same time.
- * The variable is loaded with the address of the main coroutine when the library is initialized,
- * and it is updated every time a coroutine is switched to.
+ * @brief Suspends the current coroutine and makes @p next, whose arguments are valid, the current one.
  * 
- * @note It does not need to be atomic because it is thread-local.
+ * @return cco_coroutine* The coroutine being suspended, which shall switch to @p next.
  */
-CCO_PRIVATE thread_local cco_coroutine* volatile cco_current_coroutine = NULL;
-
-CCO_PRIVATE bool
-cco_await_true_callback(cco_coroutine* coroutine, void* argument)
+CCO_PRIVATE always_inline cco_coroutine*
+cco_transfer_prepare(cco_coroutine* next)
 {
-    (void)coroutine;
-    (void)argument;
-    return true;
+    cco_coroutine* current = cco_current_coroutine;
+    /*
+        The caller chain is handed over: whoever resumed the current coroutine becomes the caller of next, so that
+        a cco_yield() or cco_return() at the end of a pipeline gets back there directly.
+    */
+    next->caller          = current->caller;
+    cco_current_coroutine = next;
+    cco_coroutine_set_state(next, CCO_COROUTINE_STATE_RUNNING);
+    cco_coroutine_set_state(current, CCO_COROUTINE_STATE_SUSPENDED);
+    return current;
 }
 
-CCO_PRIVATE bool
-cco_await_false_callback(cco_coroutine* coroutine, void* argument)
+CCO_API_INTERNAL void*
+cco_transfer(cco_coroutine* next, void* value)
 {
-    (void)coroutine;
-    (void)argument;
-    return false;
+    cco_error error = cco_transfer_check(next);
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(next);
+    }
+    if(error != CCO_OK) {
+        *cco_errno_location() = error;
+        return NULL;
+    }
+    value = cco_cswitch(cco_transfer_prepare(next), next, value);
+    /* resumed, either by cco_resume() or by another cco_transfer() */
+    *cco_errno_location() = CCO_OK;
+    return value;
 }
 
-CCO_API_INTERNAL const cco_await_callback cco_await_not_ready = cco_await_false_callback;
-
-CCO_API_INTERNAL const cco_await_callback cco_await_ready = cco_await_true_callback;
+CCO_API_INTERNAL cco_error
+cco_transfer_fast(cco_coroutine* next, void* value)
+{
+#if CCO_FAST_PATH_CHECKS
+    const cco_error error = cco_transfer_check(next);
+    if(error != CCO_OK) {
+        return error;
+    }
+#endif
+    const cco_error claimed = cco_shared_stack_claim(next);
+    if(claimed != CCO_OK) {
+        return claimed;
+    }
+    return cco_cswitch_fast(cco_transfer_prepare(next), next, value);
+}
 
 /**
- * @brief Constructor function of the library, called before main() and used to initialize the global variables.
+ * @brief Body of the big stack coroutine, which never returns: it runs a call each time it is switched to.
  */
-CCO_PRIVATE void ctor
-cco_init(void)
+CCO_PRIVATE void
+cco_big_stack_loop(unused void* argument)
 {
-    const cco_architecture_specific_settings* settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
-    for(int i = 0; i != sizeof(cco_architecture_specific_settings); ++i) {
-        ((uint8_t*)&cco_main_coroutine.settings)[i] = ((uint8_t*)settings)[i];
+    for(;;) {
+        cco_big_stack_call* call = cco_big_stack_current;
+        call->result             = call->function(call->argument);
+        cco_cswitch(cco_big_stack, call->caller, NULL);
     }
-    cco_main_coroutine.context = (cco_cpu_context*)cco_main_context;
-    cco_main_coroutine.state   = CCO_COROUTINE_STATE_RUNNING;
-    cco_current_coroutine      = &cco_main_coroutine;
 }
 
-CCO_API_INTERNAL cco_coroutine*
-cco_coroutine_create(size_t stack_size, const cco_architecture_specific_settings* settings)
+CCO_API_INTERNAL void*
+cco_call_on_big_stack(cco_big_stack_function function, void* argument)
 {
-    if(stack_size == 0) {
+    if(!function) {
         *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
         return NULL;
     }
-
-    cco_coroutine* out = (cco_coroutine*)cco_alloc(sizeof(cco_coroutine));
-    if(out) {
-        out->stack_size = stack_size;
-        out->stack      = (uint8_t*)cco_alloc(stack_size);
-        if(!out->stack) {
-            cco_free(out);
-            out                   = NULL;
-            *cco_errno_location() = CCO_ERROR_NO_MEMORY;
-        }
-        else {
-            if(!settings) {
-                settings = CCO_DEFAULT_ARCHITECTURE_SPECIFIC_SETTINGS();
-            }
-            for(size_t i = 0; i < sizeof(cco_architecture_specific_settings); ++i) {
-                ((uint8_t*)&out->settings)[i] = ((uint8_t*)settings)[i];
-            }
-            out->context = (cco_cpu_context*)cco_aligned_alloc(cco_get_cpu_context_size(settings), 32);
-            if(!out->context) {
-                cco_free(out->stack);
-                cco_free(out);
-                out                   = NULL;
-                *cco_errno_location() = CCO_ERROR_NO_MEMORY;
-            }
-            else {
-                out->state            = CCO_COROUTINE_STATE_UNSCHEDULED;
-                *cco_errno_location() = CCO_OK;
-            }
-        }
+    if(cco_big_stack_current) {
+        *cco_errno_location() = CCO_OK;
+        return function(argument);
     }
-    else {
-        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+    if(!cco_big_stack) {
+        // no optional register: the switches back and forth shall cost as little as possible
+        cco_architecture_specific_settings settings;
+        memset(&settings, 0, sizeof(settings));
+        cco_big_stack = cco_coroutine_create_from(NULL, CCO_BIG_STACK_SIZE, &settings, CCO_COROUTINE_FLAG_GUARDED_STACK);
+        if(!cco_big_stack) {
+            return NULL;
+        }
+        cco_big_stack->callback = cco_big_stack_loop;
+        cco_prepare_coroutine(cco_big_stack);
     }
-    return out;
+    cco_big_stack_call call = {function, argument, NULL, cco_current_coroutine};
+    cco_big_stack_current   = &call;
+    *cco_errno_location()   = CCO_OK;
+    cco_cswitch(cco_current_coroutine, cco_big_stack, NULL);
+    cco_big_stack_current = NULL;
+    return call.result;
 }
 
 CCO_API_INTERNAL void
-cco_coroutine_destroy(cco_coroutine* coroutine)
+cco_release_big_stack(void)
 {
-    if(coroutine) {
-        if(coroutine != &cco_main_coroutine) {
-            // cco_cpu_context return_context;
-            // memcpy(&return_context, coroutine->context, sizeof(cco_cpu_context));
-            // cco_free(coroutine->stack);
-            // TODO this will be a problem. We're pulling the rug out from under our feet:
-            // to perform a context switch we are using the stack of the coroutine we're destroying.
-            // We need to find a way to switch to the calling context without using the stack of the
-            // coroutine we're destroying.
-            // For now I will just add a check to not destroy the current coroutine.
-            if(coroutine == cco_current_coroutine) {
-                *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
-                return;
-            }
-            cco_aligned_free(coroutine->context);
-            cco_free(coroutine->stack);
-            cco_free(coroutine);
-            *cco_errno_location() = CCO_OK;
-        }
-        else {
-            *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
-        }
+    if(cco_big_stack_current) {
+        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+        return;
     }
-    else {
-        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    if(cco_big_stack) {
+        cco_coroutine_free(cco_big_stack);
+        cco_big_stack = NULL;
     }
+    *cco_errno_location() = CCO_OK;
 }
 
-CCO_PRIVATE no_inline void
-cco_coroutine_entry_point(cco_coroutine* coroutine)
+struct cco_scheduler {
+    const cco_allocator* allocator;
+    cco_coroutine*       head; /* next coroutine to run, NULL if the queue is empty */
+    cco_coroutine**      tail; /* link the next coroutine queued is stored to: &head, or &next of the last one */
+};
+
+/**
+ * @brief Queues @p coroutine at the tail of the ready queue of @p scheduler, linking it through its next member.
+ * 
+ * @details Nothing is done if it is already queued: linking it twice would make the queue a cycle. The callers check
+ * that it is not queued by another scheduler, whose queue its next member links it in.
+ */
+CCO_PRIVATE always_inline void
+cco_scheduler_push(cco_scheduler* scheduler, cco_coroutine* coroutine)
 {
-    coroutine->state = CCO_COROUTINE_STATE_RUNNING;
-    coroutine->callback(coroutine->arg);
-    cco_return(NULL);
+    if(coroutine->scheduler) {
+        return;
+    }
+    coroutine->scheduler = scheduler;
+    coroutine->next      = NULL;
+    *scheduler->tail     = coroutine;
+    scheduler->tail      = &coroutine->next;
 }
 
-CCO_API_INTERNAL bool
-cco_coroutine_start(cco_coroutine* coroutine, cco_coroutine_callback callback, void* arg)
+/**
+ * @brief Dequeues the coroutine at the head of the ready queue of @p scheduler, NULL if the queue is empty.
+ */
+CCO_PRIVATE always_inline cco_coroutine*
+cco_scheduler_pop(cco_scheduler* scheduler)
 {
-    bool ret = false;
+    cco_coroutine* coroutine = scheduler->head;
     if(coroutine) {
-        if(coroutine->state == CCO_COROUTINE_STATE_UNSCHEDULED) {
-            if(callback) {
-                ret                         = true;
-                *cco_errno_location()       = CCO_OK;
-                coroutine->callback         = callback;
-                coroutine->arg              = arg;
-                coroutine->caller           = cco_current_coroutine;
-                coroutine->await_ready      = cco_await_not_ready;
-                coroutine->await_on_suspend = NULL;
-                cco_prepare_coroutine(coroutine);
-                cco_current_coroutine = coroutine;
-                cco_cswitch(coroutine->caller, coroutine);
-                /*
-                    Notice that after cco_cswitch we will return in the context of the coroutine, hence we will
-                    come back to this context only when the coroutine will yield or return (explicitly or implicitly).
-                */
-                cco_current_coroutine = coroutine->caller;
-            }
-            else {
-                *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
-            }
+        coroutine->scheduler = NULL;
+        if(!(scheduler->head = coroutine->next)) {
+            scheduler->tail = &scheduler->head;
         }
-        else {
-            *cco_errno_location() = CCO_ERROR_SCHEDULED;
-        }
-    }
-    else {
-        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
     }
-    return ret;
+    return coroutine;
 }
 
-CCO_API_INTERNAL cco_coroutine*
-cco_this_coroutine(void)
+CCO_API_INTERNAL cco_scheduler*
+cco_scheduler_create(void)
 {
+    const cco_allocator* allocator = cco_get_allocator();
+    cco_scheduler*       scheduler = (cco_scheduler*)cco_allocator_allocate(allocator, sizeof(cco_scheduler));
+    if(!scheduler) {
+        *cco_errno_location() = CCO_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    scheduler->allocator  = allocator;
+    scheduler->head       = NULL;
+    scheduler->tail       = &scheduler->head;
     *cco_errno_location() = CCO_OK;
-    return cco_current_coroutine != &cco_main_coroutine ? cco_current_coroutine : NULL;
+    return scheduler;
 }
 
 CCO_API_INTERNAL void
-cco_return(void* value)
+cco_scheduler_destroy(cco_scheduler* scheduler)
 {
-    if(cco_current_coroutine == &cco_main_coroutine) {
-        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+    if(scheduler) {
+        // the coroutines still queued are left as if they had never been, so that they can be destroyed
+        for(cco_coroutine* coroutine; (coroutine = cco_scheduler_pop(scheduler)) != NULL;) {
+            coroutine->spawned = false;
+        }
+        cco_allocator_deallocate(scheduler->allocator, scheduler, sizeof(cco_scheduler));
+        *cco_errno_location() = CCO_OK;
     }
     else {
-        cco_coroutine* current = cco_current_coroutine;
-        cco_coroutine* caller  = current->caller;
-        *cco_errno_location()  = CCO_OK;
-        current->return_value  = value;
-        current->state         = CCO_COROUTINE_STATE_UNSCHEDULED;
-        cco_current_coroutine  = caller;
-        cco_cswitch(current, caller);
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
     }
 }
 
-CCO_API_INTERNAL void
-cco_suspend(void)
+CCO_API_INTERNAL bool
+cco_spawn(cco_scheduler* scheduler, cco_coroutine* coroutine, cco_coroutine_callback function, void* argument)
 {
-    if(cco_current_coroutine == &cco_main_coroutine) {
-        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+    if(!scheduler || !coroutine || !function) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return false;
     }
-    else {
-        cco_coroutine* current = cco_current_coroutine;
-        cco_coroutine* caller  = current->caller;
-        *cco_errno_location()  = CCO_OK;
-        current->state         = CCO_COROUTINE_STATE_SUSPENDED;
-        cco_current_coroutine  = caller;
-        cco_cswitch(current, caller);
+    if(coroutine->scheduler || cco_coroutine_load_state(coroutine) != CCO_COROUTINE_STATE_UNSCHEDULED) {
+        *cco_errno_location() = CCO_ERROR_SCHEDULED;
+        return false;
     }
+    // started by cco_scheduler_run() with them, as it finds the coroutine spawned
+    coroutine->callback = function;
+    coroutine->arg      = argument;
+    coroutine->spawned  = true;
+    cco_scheduler_push(scheduler, coroutine);
+    *cco_errno_location() = CCO_OK;
+    return true;
 }
 
 CCO_API_INTERNAL void
-cco_resume(cco_coroutine* coroutine)
+cco_scheduler_wake(cco_scheduler* scheduler, cco_coroutine* coroutine)
 {
-    if(coroutine) {
-        if(coroutine == &cco_main_coroutine) {
-            *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
-            return;
-        }
-        if(coroutine->state == CCO_COROUTINE_STATE_SUSPENDED) {
-            *cco_errno_location() = CCO_OK;
-            coroutine->caller     = cco_current_coroutine;
-            coroutine->state      = CCO_COROUTINE_STATE_RUNNING;
-            cco_cswitch(coroutine->caller, cco_current_coroutine = coroutine);
-        }
-        else {
-            *cco_errno_location() = CCO_ERROR_NOT_SUSPENDED;
-        }
-    }
-    else {
+    if(!scheduler || !coroutine) {
         *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return;
     }
+    if(cco_coroutine_load_state(coroutine) != CCO_COROUTINE_STATE_SUSPENDED) {
+        *cco_errno_location() = CCO_ERROR_NOT_SUSPENDED;
+        return;
+    }
+    if(coroutine->scheduler && coroutine->scheduler != scheduler) {
+        *cco_errno_location() = CCO_ERROR_SCHEDULED;
+        return;
+    }
+    cco_scheduler_push(scheduler, coroutine);
+    *cco_errno_location() = CCO_OK;
 }
 
 CCO_API_INTERNAL void
-cco_yield(void* value)
+cco_scheduler_yield(cco_scheduler* scheduler)
 {
-    if(cco_current_coroutine == &cco_main_coroutine) {
-        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+    cco_error error = scheduler ? cco_coroutine_context_check() : CCO_ERROR_INVALID_ARGUMENT;
+    if(error == CCO_OK) {
+        error = cco_shared_stack_claim(cco_current_coroutine->caller);
     }
-    else {
-        cco_coroutine* current = cco_current_coroutine;
-        cco_coroutine* caller  = current->caller;
-        *cco_errno_location()  = CCO_OK;
-        current->return_value  = value;
-        current->state         = CCO_COROUTINE_STATE_SUSPENDED;
-        cco_current_coroutine  = caller;
-        cco_cswitch(current, caller);
+    *cco_errno_location() = error;
+    if(error == CCO_OK) {
+        cco_scheduler_push(scheduler, cco_current_coroutine);
+        cco_coroutine* current = cco_suspend_prepare();
+        cco_cswitch(current, current->caller, NULL);
+    }
+}
+
+CCO_API_INTERNAL size_t
+cco_scheduler_run(cco_scheduler* scheduler)
+{
+    if(!scheduler) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    cco_thread_setup_once();
+    size_t    runs  = 0;
+    cco_error error = CCO_OK;
+    for(cco_coroutine* coroutine; (coroutine = cco_scheduler_pop(scheduler)) != NULL;) {
+        // a coroutine started, resumed or returned by other means since it was queued is run only if it is suspended
+        const bool                spawned = coroutine->spawned;
+        const cco_coroutine_state state   = cco_coroutine_load_state(coroutine);
+        coroutine->spawned                = false;
+        // one which cannot be switched to from here, e.g. sharing its stack with the running coroutine, is dropped
+        if(state == CCO_COROUTINE_STATE_UNSCHEDULED && spawned) {
+            cco_error check = cco_coroutine_start_check(coroutine, coroutine->callback);
+            if(check == CCO_OK) {
+                check = cco_shared_stack_claim(coroutine);
+            }
+            if(check == CCO_OK) {
+                cco_coroutine_start_switch(coroutine, coroutine->callback, coroutine->arg);
+                ++runs;
+            }
+            else {
+                error = check;
+            }
+        }
+        else if(state == CCO_COROUTINE_STATE_SUSPENDED) {
+            cco_error check = cco_resume_check(coroutine);
+            if(check == CCO_OK) {
+                check = cco_shared_stack_claim(coroutine);
+            }
+            if(check == CCO_OK) {
+                cco_cswitch(cco_resume_prepare(coroutine), coroutine, NULL);
+                ++runs;
+            }
+            else {
+                error = check;
+            }
+        }
     }
+    *cco_errno_location() = error;
+    return runs;
 }
 
+CCO_API_INTERNAL const cco_await_callback cco_scheduler_park = cco_await_true_callback;
+
 CCO_API_INTERNAL void
 cco_register_awaitable(cco_await_callback ready, cco_await_callback on_suspend)
 {
@@ -351,38 +1614,42 @@ cco_register_awaitable(cco_await_callback ready, cco_await_callback on_suspend)
 CCO_API_INTERNAL void
 cco_await(void* arg)
 {
+    const cco_error error = cco_coroutine_context_check();
+    if(error != CCO_OK) {
+        *cco_errno_location() = error;
+        return;
+    }
     cco_await_with(cco_current_coroutine->await_ready, cco_current_coroutine->await_on_suspend, arg);
 }
 
 CCO_API_INTERNAL void
 cco_await_with(cco_await_callback ready, cco_await_callback on_suspend, void* arg)
 {
+    const cco_error error = cco_coroutine_context_check();
+    if(error != CCO_OK || !(ready || on_suspend)) {
+        *cco_errno_location() = error != CCO_OK ? error : CCO_ERROR_INVALID_ARGUMENT;
+        return;
+    }
     cco_coroutine* current = cco_current_coroutine;
     cco_coroutine* caller  = current->caller;
-    if(cco_current_coroutine != &cco_main_coroutine) {
-        if(!(ready || on_suspend)) {
-            *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+    *cco_errno_location()  = CCO_OK;
+    while(true) {
+        if(ready && ready(current, arg)) {
             return;
         }
-        *cco_errno_location() = CCO_OK;
-        while(true) {
-            if(ready && ready(cco_current_coroutine, arg)) {
-                return;
-            }
-            else {
-                current->state = CCO_COROUTINE_STATE_SUSPENDED;
-                if(!on_suspend || on_suspend(current, arg)) {
-                    goto suspend;
-                }
-            }
+        // on_suspend() may hand the coroutine over as suspended: from there on, the switch cannot fail any more
+        const cco_error claimed = cco_shared_stack_claim(caller);
+        if(claimed != CCO_OK) {
+            *cco_errno_location() = claimed;
+            return;
+        }
+        cco_coroutine_set_state(current, CCO_COROUTINE_STATE_SUSPENDED);
+        if(!on_suspend || on_suspend(current, arg)) {
+            break;
         }
     }
-    else {
-        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
-    }
-suspend:
     cco_current_coroutine = caller;
-    cco_cswitch(current, caller);
+    cco_cswitch(current, caller, NULL);
 }
 
 CCO_API_INTERNAL const char* const cco_coroutine_state_strings[4] = {
@@ -396,14 +1663,15 @@ CCO_API_INTERNAL cco_coroutine_state
 cco_coroutine_get_state(const cco_coroutine* coroutine)
 {
     if(coroutine) {
-        *cco_errno_location() = CCO_OK;
-        switch(coroutine->state) {
+        *cco_errno_location()           = CCO_OK;
+        const cco_coroutine_state state = cco_coroutine_load_state(coroutine);
+        switch(state) {
         case CCO_COROUTINE_STATE_RUNNING:      // fallthrough;
         case CCO_COROUTINE_STATE_SUSPENDED:    // fallthrough;
         case CCO_COROUTINE_STATE_UNSCHEDULED:  // fallthrough;
             {
                 *cco_errno_location() = CCO_OK;
-                return coroutine->state;
+                return state;
             }
         default:
             {
@@ -418,6 +1686,49 @@ cco_coroutine_get_state(const cco_coroutine* coroutine)
     }
 }
 
+CCO_API_INTERNAL bool
+cco_coroutine_release(cco_coroutine* coroutine)
+{
+    if(!coroutine || coroutine == &cco_main_coroutine || coroutine->shared_stack) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return false;
+    }
+    // suspended, but still on its own stack: its context is saved only once it gives control back
+    if(coroutine == cco_current_coroutine) {
+        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+        return false;
+    }
+    const cco_coroutine_state state = cco_coroutine_load_state(coroutine);
+    if(state != CCO_COROUTINE_STATE_SUSPENDED && state != CCO_COROUTINE_STATE_UNSCHEDULED) {
+        *cco_errno_location() = state == CCO_COROUTINE_STATE_RUNNING ? CCO_ERROR_NOT_SUSPENDED : CCO_ERROR_INVALID_ARGUMENT;
+        return false;
+    }
+    // everything this thread wrote to the coroutine and to its stack, the saved context included, comes before this
+    atomic_store_explicit(&coroutine->released, true, memory_order_release);
+    *cco_errno_location() = CCO_OK;
+    return true;
+}
+
+CCO_API_INTERNAL bool
+cco_coroutine_acquire(cco_coroutine* coroutine)
+{
+    cco_thread_setup_once();
+    if(!coroutine || coroutine == &cco_main_coroutine) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return false;
+    }
+    // a single thread wins the coroutine, and sees what the releasing thread wrote
+    bool released = true;
+    if(!atomic_compare_exchange_strong_explicit(
+           &coroutine->released, &released, false, memory_order_acquire, memory_order_relaxed
+       )) {
+        *cco_errno_location() = CCO_ERROR_NOT_RELEASED;
+        return false;
+    }
+    *cco_errno_location() = CCO_OK;
+    return true;
+}
+
 CCO_API_INTERNAL size_t
 cco_coroutine_get_stack_size(const cco_coroutine* coroutine)
 {
@@ -445,19 +1756,20 @@ CCO_API_INTERNAL size_t
 cco_coroutine_get_stack_usage(const cco_coroutine* coroutine)
 {
     if(coroutine) {
+        const cco_coroutine_state state = cco_coroutine_load_state(coroutine);
         if(coroutine == cco_current_coroutine) {
             *cco_errno_location() = CCO_OK;
             return coroutine->stack + coroutine->stack_size - cco_current_stack_pointer();
         }
-        else if(coroutine->state == CCO_COROUTINE_STATE_SUSPENDED) {
+        else if(state == CCO_COROUTINE_STATE_SUSPENDED) {
             *cco_errno_location() = CCO_OK;
             return coroutine->stack + coroutine->stack_size - cco_get_stack_pointer(coroutine);
         }
-        else if(coroutine->state == CCO_COROUTINE_STATE_UNSCHEDULED) {
+        else if(state == CCO_COROUTINE_STATE_UNSCHEDULED) {
             *cco_errno_location() = CCO_OK;
             return 0;
         }
-        else if(coroutine->state == CCO_COROUTINE_STATE_NONE) {
+        else if(state == CCO_COROUTINE_STATE_NONE) {
             *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
             return 0;
         }
@@ -472,6 +1784,46 @@ cco_coroutine_get_stack_usage(const cco_coroutine* coroutine)
     }
 }
 
+CCO_API_INTERNAL size_t
+cco_coroutine_get_stack_peak(const cco_coroutine* coroutine)
+{
+    if(!coroutine || coroutine == &cco_main_coroutine || cco_coroutine_load_state(coroutine) == CCO_COROUTINE_STATE_NONE) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+#if CCO_STACK_PAINTING
+    const size_t peak     = coroutine->stack_size - cco_scan_stack(coroutine->stack, coroutine->stack_size);
+    *cco_errno_location() = CCO_OK;
+    return peak > coroutine->stack_peak ? peak : coroutine->stack_peak;
+#else
+    *cco_errno_location() = CCO_ERROR_NOT_SUPPORTED;
+    return 0;
+#endif
+}
+
+CCO_API_INTERNAL size_t
+cco_coroutine_trim_stack(cco_coroutine* coroutine)
+{
+    const cco_coroutine_state state = coroutine ? cco_coroutine_load_state(coroutine) : CCO_COROUTINE_STATE_NONE;
+    if(coroutine == &cco_main_coroutine || state == CCO_COROUTINE_STATE_NONE) {
+        *cco_errno_location() = CCO_ERROR_INVALID_ARGUMENT;
+        return 0;
+    }
+    if(state == CCO_COROUTINE_STATE_RUNNING) {
+        *cco_errno_location() = CCO_ERROR_INVALID_CONTEXT;
+        return 0;
+    }
+    size_t trimmed = 0;
+    // the frames of the other coroutines on a shared stack are not ours to discard
+    if(!coroutine->shared_stack || coroutine->shared_stack->owner == coroutine) {
+        const uint8_t* sp = state == CCO_COROUTINE_STATE_SUSPENDED ? cco_get_stack_pointer(coroutine)
+                                                                     : coroutine->stack + coroutine->stack_size;
+        trimmed = cco_trim_stack_below(coroutine, sp);
+    }
+    *cco_errno_location() = CCO_OK;
+    return trimmed;
+}
+
 CCO_API_INTERNAL void*
 cco_coroutine_get_return_value(const cco_coroutine* coroutine)
 {
@@ -23,25 +23,19 @@
 extern "C" {
 #endif
 
-CCO_PRIVATE thread_local cco_error  cco_errno_instance = CCO_OK;
-CCO_PRIVATE thread_local cco_error* cco_errno_loc;
-
-void ctor
-cco_errno_init(void)
-{
-    cco_errno_loc = &cco_errno_instance;
-}
+/** Statically initialized, hence valid on every thread from its start, with no setup. */
+CCO_PRIVATE thread_local cco_error cco_errno_instance initial_exec = CCO_OK;
 
 CCO_API_INTERNAL const cco_error*
 cco_errno_ptr(void)
 {
-    return cco_errno_loc;
+    return &cco_errno_instance;
 }
 
 cco_error*
 cco_errno_location(void)
 {
-    return cco_errno_loc;
+    return &cco_errno_instance;
 }
 
 CCO_API_INTERNAL const char*
@@ -56,6 +50,8 @@ cco_strerror(cco_error error)
     case CCO_ERROR_UNSCHEDULED: return "coroutine was not scheduled";
     case CCO_ERROR_NOT_SUSPENDED: return "coroutine was not suspended";
     case CCO_ERROR_NOT_RUNNING: return "coroutine was not running";
+    case CCO_ERROR_NOT_SUPPORTED: return "feature not supported by this build";
+    case CCO_ERROR_NOT_RELEASED: return "coroutine was not released by its thread";
     default: return "unknown error";
     }
 }
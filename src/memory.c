@@ -0,0 +1,264 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/memory.c
+ *
+ * @brief Static page allocator behind cco_alloc() and cco_aligned_alloc().
+ *
+ * @details When STATIC_MALLOC_N_PAGES is not 0, a region of that many pages of STATIC_MALLOC_PAGE_SIZE bytes is reserved
+ * in the data segment of the library, and every allocation of the library is served from it as a block of exactly the
+ * number of pages it needs: a coroutine with a 64 KiB stack takes 17 pages of 4 KiB, so that N pages hold about N / 17
+ * of them. Freed blocks are kept in one free list per block length, in pages, and reused as they are, without splitting
+ * nor coalescing: the blocks of a program creating coroutines with the same stack size always have the same length, so
+ * that the region is carved at most once and then recycled. Only when the region is exhausted, or for requests it cannot
+ * serve, the allocation falls back to the C library. The bookkeeping takes 16 bytes per page at most, outside of the
+ * region.
+ *
+ * With STATIC_MALLOC_THREAD_SAFE_LOCK_FREE the free lists are Treiber stacks whose heads carry a modification counter
+ * against the ABA problem, and the uncarved part of the region is claimed with a compare-and-swap on the counter of the
+ * pages already carved (cco_static_pages_used).
+ * Every failed compare-and-swap spins for a while before retrying, up to STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT
+ * times a pause instruction, doubling the wait on each failure with
+ * STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_EXPONENTIAL_BACKOFF. Otherwise, the same structures are protected by a spin
+ * lock with the same backoff if STATIC_MALLOC_THREAD_SAFE, and by nothing at all if not.
+ */
+
+#include "memory.h"
+
+#if CCO_STATIC_MALLOC_N_PAGES
+
+#  include <stdint.h>
+#  include <string.h>
+
+#  if CCO_STATIC_MALLOC_THREAD_SAFE
+#    include <stdatomic.h>
+#  endif
+
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+
+_Static_assert(
+    (CCO_STATIC_MALLOC_PAGE_SIZE & (CCO_STATIC_MALLOC_PAGE_SIZE - 1)) == 0, "STATIC_MALLOC_PAGE_SIZE shall be a power of two"
+);
+_Static_assert(CCO_STATIC_MALLOC_N_PAGES < UINT32_MAX, "STATIC_MALLOC_N_PAGES shall fit in 32 bits");
+
+CCO_PRIVATE _Alignas(CCO_STATIC_MALLOC_PAGE_SIZE) unsigned char cco_static_pages[CCO_STATIC_MALLOC_N_PAGES]
+                                                                                 [CCO_STATIC_MALLOC_PAGE_SIZE];
+
+/** Length in pages of each allocated block, stored at the index of its first page. */
+CCO_PRIVATE uint32_t cco_static_block_pages[CCO_STATIC_MALLOC_N_PAGES];
+
+#  if CCO_STATIC_MALLOC_THREAD_SAFE && CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE
+/**
+ * Heads of the free lists of the blocks of 1 to STATIC_MALLOC_N_PAGES pages, by length minus one: the modification
+ * counter in the upper half, the first page plus one in the lower half.
+ */
+CCO_PRIVATE _Atomic uint64_t cco_static_free_lists[CCO_STATIC_MALLOC_N_PAGES];
+/** Next block of the free list each free block belongs to, plus one. */
+CCO_PRIVATE _Atomic uint32_t cco_static_free_next[CCO_STATIC_MALLOC_N_PAGES];
+/** Number of pages carved from the region so far. */
+CCO_PRIVATE _Atomic uint32_t cco_static_pages_used;
+#  else
+CCO_PRIVATE uint32_t cco_static_free_lists[CCO_STATIC_MALLOC_N_PAGES];
+CCO_PRIVATE uint32_t cco_static_free_next[CCO_STATIC_MALLOC_N_PAGES];
+CCO_PRIVATE uint32_t cco_static_pages_used;
+#    if CCO_STATIC_MALLOC_THREAD_SAFE
+CCO_PRIVATE atomic_flag cco_static_lock = ATOMIC_FLAG_INIT;
+#    endif
+#  endif
+
+#  if CCO_STATIC_MALLOC_THREAD_SAFE
+CCO_PRIVATE always_inline void
+cco_cpu_relax(void)
+{
+#    if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#    elif defined(_M_IX86) || defined(_M_X64)
+    _mm_pause();
+#    elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#    endif
+}
+
+/**
+ * @brief Waits after a failed attempt, for longer at each call if the backoff is exponential.
+ *
+ * @param spins the number of pauses to wait for, updated for the next call
+ */
+CCO_PRIVATE always_inline void
+cco_static_backoff(unsigned int* spins)
+{
+    for(unsigned int i = 0; i != *spins; ++i) {
+        cco_cpu_relax();
+    }
+#    if CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_EXPONENTIAL_BACKOFF
+    if(*spins < CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT) {
+        *spins *= 2;
+        if(*spins > CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT) {
+            *spins = CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT;
+        }
+    }
+#    endif
+}
+#  endif
+
+#  if CCO_STATIC_MALLOC_THREAD_SAFE && CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE
+
+CCO_PRIVATE uint32_t
+cco_static_pop(uint32_t list)
+{
+    unsigned int spins = 1;
+    uint64_t     head  = atomic_load_explicit(&cco_static_free_lists[list], memory_order_acquire);
+    while((uint32_t)head) {
+        const uint32_t page = (uint32_t)head - 1;
+        const uint32_t next = atomic_load_explicit(&cco_static_free_next[page], memory_order_relaxed);
+        const uint64_t desired = ((head >> 32) + 1) << 32 | next;
+        if(atomic_compare_exchange_weak_explicit(
+               &cco_static_free_lists[list], &head, desired, memory_order_acquire, memory_order_acquire
+           )) {
+            return page + 1;
+        }
+        cco_static_backoff(&spins);
+    }
+    return 0;
+}
+
+CCO_PRIVATE void
+cco_static_push(uint32_t list, uint32_t page)
+{
+    unsigned int spins = 1;
+    uint64_t     head  = atomic_load_explicit(&cco_static_free_lists[list], memory_order_relaxed);
+    for(;;) {
+        atomic_store_explicit(&cco_static_free_next[page], (uint32_t)head, memory_order_relaxed);
+        const uint64_t desired = ((head >> 32) + 1) << 32 | (page + 1);
+        if(atomic_compare_exchange_weak_explicit(
+               &cco_static_free_lists[list], &head, desired, memory_order_release, memory_order_relaxed
+           )) {
+            return;
+        }
+        cco_static_backoff(&spins);
+    }
+}
+
+CCO_PRIVATE uint32_t
+cco_static_carve(uint32_t pages)
+{
+    unsigned int spins = 1;
+    uint32_t     used  = atomic_load_explicit(&cco_static_pages_used, memory_order_relaxed);
+    while(CCO_STATIC_MALLOC_N_PAGES - used >= pages) {
+        if(atomic_compare_exchange_weak_explicit(
+               &cco_static_pages_used, &used, used + pages, memory_order_relaxed, memory_order_relaxed
+           )) {
+            return used + 1;
+        }
+        cco_static_backoff(&spins);
+    }
+    return 0;
+}
+
+#  else
+
+CCO_PRIVATE always_inline void
+cco_static_lock_acquire(void)
+{
+#    if CCO_STATIC_MALLOC_THREAD_SAFE
+    unsigned int spins = 1;
+    while(atomic_flag_test_and_set_explicit(&cco_static_lock, memory_order_acquire)) {
+        cco_static_backoff(&spins);
+    }
+#    endif
+}
+
+CCO_PRIVATE always_inline void
+cco_static_lock_release(void)
+{
+#    if CCO_STATIC_MALLOC_THREAD_SAFE
+    atomic_flag_clear_explicit(&cco_static_lock, memory_order_release);
+#    endif
+}
+
+CCO_PRIVATE uint32_t
+cco_static_pop(uint32_t list)
+{
+    cco_static_lock_acquire();
+    const uint32_t head = cco_static_free_lists[list];
+    if(head) {
+        cco_static_free_lists[list] = cco_static_free_next[head - 1];
+    }
+    cco_static_lock_release();
+    return head;
+}
+
+CCO_PRIVATE void
+cco_static_push(uint32_t list, uint32_t page)
+{
+    cco_static_lock_acquire();
+    cco_static_free_next[page]  = cco_static_free_lists[list];
+    cco_static_free_lists[list] = page + 1;
+    cco_static_lock_release();
+}
+
+CCO_PRIVATE uint32_t
+cco_static_carve(uint32_t pages)
+{
+    uint32_t page = 0;
+    cco_static_lock_acquire();
+    if(CCO_STATIC_MALLOC_N_PAGES - cco_static_pages_used >= pages) {
+        page = cco_static_pages_used + 1;
+        cco_static_pages_used += pages;
+    }
+    cco_static_lock_release();
+    return page;
+}
+
+#  endif
+
+hidden void*
+cco_static_alloc(size_t size)
+{
+    if(size == 0 || size > (size_t)CCO_STATIC_MALLOC_N_PAGES * CCO_STATIC_MALLOC_PAGE_SIZE) {
+        return NULL;
+    }
+    const uint32_t pages = (uint32_t)((size + CCO_STATIC_MALLOC_PAGE_SIZE - 1) / CCO_STATIC_MALLOC_PAGE_SIZE);
+    uint32_t       page  = cco_static_pop(pages - 1);
+    if(!page) {
+        page = cco_static_carve(pages);
+    }
+    if(!page) {
+        return NULL;
+    }
+    cco_static_block_pages[page - 1] = pages;
+    return cco_static_pages[page - 1];
+}
+
+hidden bool
+cco_static_free(void* ptr)
+{
+    const uintptr_t address = (uintptr_t)ptr;
+    const uintptr_t begin   = (uintptr_t)cco_static_pages;
+    if(address < begin || address >= begin + sizeof(cco_static_pages)) {
+        return false;
+    }
+    const uint32_t page = (uint32_t)((address - begin) / CCO_STATIC_MALLOC_PAGE_SIZE);
+    cco_static_push(cco_static_block_pages[page] - 1, page);
+    return true;
+}
+
+#endif
@@ -22,52 +22,120 @@
 #include "api.h"
 #include "compiler.h"
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #if defined(_WIN32) || defined(_WIN64)
 #  include <malloc.h>
+#  include <windows.h>
+#elif __unix__
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/* Defaults of the settings in CMakeLists.txt, for builds not going through it. */
+#ifndef CCO_STATIC_MALLOC_N_PAGES
+#  define CCO_STATIC_MALLOC_N_PAGES 0
+#endif
+#ifndef CCO_STATIC_MALLOC_PAGE_SIZE
+#  define CCO_STATIC_MALLOC_PAGE_SIZE 4096
+#endif
+#ifndef CCO_STATIC_MALLOC_THREAD_SAFE
+#  define CCO_STATIC_MALLOC_THREAD_SAFE 1
+#endif
+#ifndef CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE
+#  define CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE 1
+#endif
+#ifndef CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT
+#  define CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_COUNT 1000
+#endif
+#ifndef CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_EXPONENTIAL_BACKOFF
+#  define CCO_STATIC_MALLOC_THREAD_SAFE_LOCK_FREE_SPIN_EXPONENTIAL_BACKOFF 1
+#endif
+#ifndef CCO_GUARDED_STACKS
+#  define CCO_GUARDED_STACKS 0
+#endif
+#ifndef CCO_STACK_PAINTING
+#  define CCO_STACK_PAINTING 0
+#endif
+#ifndef CCO_TRIM_STACKS
+#  define CCO_TRIM_STACKS 0
+#endif
+#ifndef CCO_BIG_STACK_SIZE
+#  define CCO_BIG_STACK_SIZE 1048576
+#endif
+
+#if CCO_STATIC_MALLOC_N_PAGES
+/**
+ * @brief Allocates at least @p size bytes from the static page region, see memory.c.
+ *
+ * @return void* the first byte of a block aligned to STATIC_MALLOC_PAGE_SIZE, or NULL if the region is exhausted
+ */
+hidden void* cco_static_alloc(size_t size);
+
+/**
+ * @brief Gives a block back to the static page region.
+ *
+ * @return bool false if @p ptr does not belong to the region, and shall be released to the C library instead
+ */
+hidden bool cco_static_free(void* ptr);
 #endif
 
 always_inline CCO_PRIVATE void*
 cco_alloc(size_t size)
 {
+#if CCO_STATIC_MALLOC_N_PAGES
+    void* ptr = cco_static_alloc(size);
+    if(ptr) {
+        return ptr;
+    }
+#endif
     return malloc(size);
-    // TODO use a custom allocator for static sizes
 }
 
 always_inline CCO_PRIVATE void*
 cco_aligned_alloc(size_t size, size_t alignment)
 {
+    void* ptr;
+#if CCO_STATIC_MALLOC_N_PAGES
+    if(alignment <= CCO_STATIC_MALLOC_PAGE_SIZE && (ptr = cco_static_alloc(size)) != NULL) {
+        return ptr;
+    }
+#endif
 #if defined(_WIN32) || defined(_WIN64)
-    return _aligned_malloc(size, alignment);
+    ptr = _aligned_malloc(size, alignment);
 #elif __unix__
-    void* ptr;
     if(posix_memalign(&ptr, alignment, size) != 0) {
         ptr = NULL;
     }
-    for(size_t i = 0; i != size; ++i) {
-        ((char*)ptr)[i] = 0;
-    }
-    // printf("allocated %p with alignment %zu and size %zu (posix_memalign)\n", ptr, alignment, size);
-    return ptr;
-    // TODO use a custom allocator for static sizes
 #else
 #  error "Unsupported platform (aligned malloc required)"
 #endif
+    return ptr;
 }
 
 always_inline CCO_PRIVATE void
 cco_free(void* ptr)
 {
+#if CCO_STATIC_MALLOC_N_PAGES
+    if(cco_static_free(ptr)) {
+        return;
+    }
+#endif
     free(ptr);
-    // TODO use a custom allocator for static sizes
 }
 
 always_inline CCO_PRIVATE void
 cco_aligned_free(void* ptr)
 {
+#if CCO_STATIC_MALLOC_N_PAGES
+    if(cco_static_free(ptr)) {
+        return;
+    }
+#endif
 #if defined(_WIN32) || defined(_WIN64)
     _aligned_free(ptr);
 #elif __unix__
@@ -75,7 +143,187 @@ cco_aligned_free(void* ptr)
 #else
 #  error "Unsupported platform (aligned free required)"
 #endif
-    // TODO use a custom allocator for static sizes
+}
+
+/**
+ * @brief Allocates a control block from @p allocator, or from the default allocator if NULL, see cco_allocator.
+ */
+always_inline CCO_PRIVATE void*
+cco_allocator_allocate(const cco_allocator* allocator, size_t size)
+{
+    return allocator ? allocator->allocate(allocator->user_data, size) : cco_alloc(size);
+}
+
+/**
+ * @brief Releases a control block of @p size bytes obtained with cco_allocator_allocate(); @p ptr may be NULL.
+ */
+always_inline CCO_PRIVATE void
+cco_allocator_deallocate(const cco_allocator* allocator, void* ptr, size_t size)
+{
+    if(!allocator) {
+        cco_free(ptr);
+    }
+    else if(ptr) {
+        allocator->deallocate(allocator->user_data, ptr, size);
+    }
+}
+
+always_inline CCO_PRIVATE size_t
+cco_page_size(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#elif __unix__
+    return (size_t)sysconf(_SC_PAGESIZE);
+#else
+#  error "Unsupported platform (page size required)"
+#endif
+}
+
+/**
+ * @brief Maps @p size bytes of private memory preceded by @p guard inaccessible bytes.
+ *
+ * @details The memory is reserved but not committed where the system allows it, so that a page only takes physical
+ * memory once it is touched, and it reads as zero. @p size and @p guard shall be multiples of cco_page_size().
+ *
+ * @return void* the first accessible byte, right above the guard, or NULL on failure
+ */
+always_inline CCO_PRIVATE void*
+cco_map_guarded(size_t size, size_t guard)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    uint8_t* base = (uint8_t*)VirtualAlloc(NULL, guard + size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    DWORD    old_protection;
+    if(base && guard && !VirtualProtect(base, guard, PAGE_NOACCESS, &old_protection)) {
+        VirtualFree(base, 0, MEM_RELEASE);
+        base = NULL;
+    }
+    return base ? base + guard : NULL;
+#elif __unix__
+#  ifndef MAP_NORESERVE
+#    define MAP_NORESERVE 0
+#  endif
+#  ifndef MAP_STACK
+#    define MAP_STACK 0
+#  endif
+    uint8_t* base = (uint8_t*)mmap(NULL, guard + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if(base == (uint8_t*)MAP_FAILED) {
+        return NULL;
+    }
+    if(guard && mprotect(base, guard, PROT_NONE) != 0) {
+        munmap(base, guard + size);
+        return NULL;
+    }
+    return base + guard;
+#else
+#  error "Unsupported platform (virtual memory mapping required)"
+#endif
+}
+
+/** @brief Unmaps the memory returned by cco_map_guarded(), with the same @p size and @p guard. */
+always_inline CCO_PRIVATE void
+cco_unmap_guarded(void* ptr, size_t size, size_t guard)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    (void)size;
+    VirtualFree((uint8_t*)ptr - guard, 0, MEM_RELEASE);
+#elif __unix__
+    munmap((uint8_t*)ptr - guard, guard + size);
+#else
+#  error "Unsupported platform (virtual memory mapping required)"
+#endif
+}
+
+/**
+ * @brief Gives the physical memory behind the whole pages of [@p ptr, @p ptr + @p size) back to the system, keeping the
+ * range mapped: a page is committed again, with unspecified content, the next time it is touched.
+ *
+ * @return bool false if the system refused, in which case the memory is left as it was
+ */
+always_inline CCO_PRIVATE bool
+cco_discard_pages(void* ptr, size_t size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE) != NULL;
+#elif __unix__
+    return madvise(ptr, size, MADV_DONTNEED) == 0;
+#else
+#  error "Unsupported platform (virtual memory mapping required)"
+#endif
+}
+
+/** Size of the huge pages cco_map_huge() maps the memory with, when it can. */
+#define CCO_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/**
+ * @brief Maps @p size bytes of private memory backed by huge pages, or by regular pages if there are none available.
+ *
+ * @details Explicit huge pages are tried first (MAP_HUGETLB, MEM_LARGE_PAGES), and they are committed right away since
+ * there is no way to fall back once a page cannot be faulted in. Otherwise the memory is mapped with regular pages,
+ * reserved but not committed, aligned to CCO_HUGE_PAGE_SIZE and marked as eligible for transparent huge pages where the
+ * system supports them. @p size shall be a multiple of CCO_HUGE_PAGE_SIZE.
+ *
+ * @param[out] huge Whether the memory is backed by huge pages, or at least eligible for transparent ones.
+ * @return void* the first byte of the memory, aligned to CCO_HUGE_PAGE_SIZE, or NULL on failure
+ */
+always_inline CCO_PRIVATE void*
+cco_map_huge(size_t size, bool* huge)
+{
+    *huge = false;
+#if defined(_WIN32) || defined(_WIN64)
+    const SIZE_T large_page_size = GetLargePageMinimum();
+    void*        ptr             = NULL;
+    if(large_page_size && size % large_page_size == 0) {
+        ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    }
+    if(ptr) {
+        *huge = true;
+        return ptr;
+    }
+    // the allocation granularity is 64 KiB: the memory is not aligned to a huge page, which is not used anyway
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif __unix__
+#  ifdef MAP_HUGETLB
+    uint8_t* ptr = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(ptr != (uint8_t*)MAP_FAILED) {
+        *huge = true;
+        return ptr;
+    }
+#  endif
+    // over-reserve, and trim the mapping to a boundary of a huge page so that it can be backed by whole ones
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    uint8_t*  base  = (uint8_t*)mmap(NULL, size + CCO_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if(base == (uint8_t*)MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)base + CCO_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(CCO_HUGE_PAGE_SIZE - 1));
+    if(aligned != base) {
+        munmap(base, (size_t)(aligned - base));
+    }
+    munmap(aligned + size, (size_t)(base + CCO_HUGE_PAGE_SIZE - aligned));
+#  ifdef MADV_HUGEPAGE
+    *huge = madvise(aligned, size, MADV_HUGEPAGE) == 0;
+#  endif
+    return aligned;
+#else
+#  error "Unsupported platform (virtual memory mapping required)"
+#endif
+}
+
+/** @brief Unmaps the memory returned by cco_map_huge(), with the same @p size. */
+always_inline CCO_PRIVATE void
+cco_unmap_huge(void* ptr, size_t size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif __unix__
+    munmap(ptr, size);
+#else
+#  error "Unsupported platform (virtual memory mapping required)"
+#endif
 }
 
 #endif
@@ -0,0 +1,237 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file test/aarch64.c
+ *
+ * @brief Test file for AArch64 architecture.
+ *
+ * @details Checks the properties of the AArch64 context switch that the black box test cannot observe: the ABI stack
+ * alignment at the coroutine entry, the callee-saved registers across switches and the optional register exchanges.
+ */
+
+#include "cco.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define STACK_SIZE (4096 * 4)
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                                                         \
+  do {                                                                                                                           \
+    if(!(condition)) {                                                                                                           \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                                                       \
+      ++failures;                                                                                                                \
+    }                                                                                                                            \
+  } while(0)
+
+static void
+check_alignment(void* arg)
+{
+    /* The ABI requires sp to be 16-byte aligned at any time. */
+    uintptr_t sp;
+    __asm__ volatile("mov %0, sp" : "=r"(sp));
+    *(uintptr_t*)arg = sp;
+}
+
+static void
+accumulate(void* arg)
+{
+    /* Enough live values to spill into every callee-saved register across the yields. */
+    volatile uint64_t* out = (volatile uint64_t*)arg;
+    uint64_t           a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8, k = 9, l = 10, m = 11;
+    for(int i = 0; i != 16; ++i) {
+        a += b;
+        b ^= c << 1;
+        c += d * 3;
+        d ^= e + i;
+        e += f;
+        f ^= g >> 1;
+        g += h;
+        h ^= k << 2;
+        k += l;
+        l ^= m >> 2;
+        m += a;
+        cco_yield(NULL);
+    }
+    *out = a ^ b ^ c ^ d ^ e ^ f ^ g ^ h ^ k ^ l ^ m;
+}
+
+static uint64_t
+accumulate_reference(void)
+{
+    uint64_t a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8, k = 9, l = 10, m = 11;
+    for(int i = 0; i != 16; ++i) {
+        a += b;
+        b ^= c << 1;
+        c += d * 3;
+        d ^= e + i;
+        e += f;
+        f ^= g >> 1;
+        g += h;
+        h ^= k << 2;
+        k += l;
+        l ^= m >> 2;
+        m += a;
+    }
+    return a ^ b ^ c ^ d ^ e ^ f ^ g ^ h ^ k ^ l ^ m;
+}
+
+/* The compiler cannot be trusted to keep a value in d8 across a call: it is written and read back explicitly. */
+static void
+set_d8(uint64_t value)
+{
+    __asm__ volatile("fmov d8, %0" : : "r"(value) : "v8");
+}
+
+static uint64_t
+get_d8(void)
+{
+    uint64_t value;
+    __asm__ volatile("fmov %0, d8" : "=r"(value));
+    return value;
+}
+
+static void
+keep_d8(void* arg)
+{
+    set_d8(0x0123456789abcdefu);
+    cco_yield(NULL);
+    *(uint64_t*)arg = get_d8();
+}
+
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+static uint64_t
+get_fpcr(void)
+{
+    uint64_t fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+}
+
+static void
+set_fpcr(uint64_t fpcr)
+{
+    __asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+}
+
+static void
+keep_rounding_mode(void* arg)
+{
+    set_fpcr((get_fpcr() & ~0xc00000u) | 0x800000u); /* round toward minus infinity */
+    cco_yield(NULL);
+    *(uint64_t*)arg = get_fpcr() & 0xc00000u;
+}
+#endif
+
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+static void
+set_v8_upper(uint64_t value)
+{
+    __asm__ volatile("mov v8.d[1], %0" : : "r"(value) : "v8");
+}
+
+static uint64_t
+get_v8_upper(void)
+{
+    uint64_t value;
+    __asm__ volatile("mov %0, v8.d[1]" : "=r"(value));
+    return value;
+}
+
+static void
+keep_v8(void* arg)
+{
+    set_v8_upper(0x0123456789abcdefu);
+    cco_yield(NULL);
+    *(uint64_t*)arg = get_v8_upper();
+}
+#endif
+
+int
+main(void)
+{
+    {
+        uintptr_t      sp        = 0;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, check_alignment, &sp));
+        CHECK(sp != 0 && sp % 16 == 0);
+        cco_coroutine_destroy(coroutine);
+    }
+
+    {
+        uint64_t       result    = 0;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, accumulate, &result));
+        while(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED) {
+            cco_resume(coroutine);
+        }
+        CHECK(result == accumulate_reference());
+        cco_coroutine_destroy(coroutine);
+    }
+
+    {
+        uint64_t       d8        = 0;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_d8, &d8));
+        set_d8(0xfedcba9876543210u); /* clobbered by the main context while the coroutine is suspended */
+        cco_resume(coroutine);
+        CHECK(d8 == 0x0123456789abcdefu);
+        cco_coroutine_destroy(coroutine);
+    }
+
+#if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    {
+        const cco_architecture_specific_settings settings  = CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS;
+        const uint64_t                           fpcr      = get_fpcr();
+        uint64_t                                 rounding  = 0;
+        cco_coroutine*                           coroutine = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_rounding_mode, &rounding));
+        /* the rounding mode of the coroutine does not leak into the main context */
+        CHECK(get_fpcr() == fpcr);
+        set_fpcr((get_fpcr() & ~0xc00000u) | 0xc00000u); /* round toward zero in the main context */
+        cco_resume(coroutine);
+        CHECK(rounding == 0x800000u);
+        CHECK((get_fpcr() & 0xc00000u) == 0xc00000u);
+        set_fpcr(fpcr);
+        cco_coroutine_destroy(coroutine);
+    }
+#endif
+
+#if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    {
+        const cco_architecture_specific_settings settings  = CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS;
+        uint64_t                                 upper     = 0;
+        cco_coroutine*                           coroutine = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_v8, &upper));
+        set_v8_upper(0xfedcba9876543210u);
+        cco_resume(coroutine);
+        CHECK(upper == 0x0123456789abcdefu);
+        cco_coroutine_destroy(coroutine);
+    }
+#endif
+
+    return failures != 0;
+}
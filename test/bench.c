@@ -0,0 +1,432 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file test/bench.c
+ *
+ * @brief Micro-benchmarks of the context switch.
+ *
+ * @details Measures the cost of a resume/yield round trip, through both the checked and the fast API, of a start/return
+ * pair, of a create/destroy pair, of a pool acquire/release pair and of a turn through the ready queue of a scheduler,
+ * once for each set of optional registers enabled at compile time, together with the same round trip through
+ * swapcontext() and through a condition variable hand-off between two threads as baselines. A round robin over
+ * thousands of coroutines compares stacks from the default allocator with stacks from a cco_arena. Every result is
+ * printed as a CSV record (benchmark, settings, iterations, nanoseconds and cycles per operation) so that runs can be
+ * compared across releases; the cycles are those of the time-stamp counter, and are 0 where there is none.
+ *
+ * Usage: cco_bench [iterations]
+ */
+
+#if !defined(_WIN32)
+#  define _GNU_SOURCE
+#endif
+
+#include "cco.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  define CCO_BENCH_BASELINES 1
+#  include <pthread.h>
+#  include <ucontext.h>
+#else
+#  define CCO_BENCH_BASELINES 0
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#  include <x86intrin.h>
+#endif
+
+#define STACK_SIZE         (4096 * 4)
+#define DEFAULT_ITERATIONS 1000000
+#define ROUND_ROBIN_COUNT  4096
+#define SCHEDULER_COUNT    4
+
+typedef struct bench_settings {
+    const char*                              name;
+    const cco_architecture_specific_settings settings;
+} bench_settings;
+
+/* Each set of optional registers enabled at compile time, on its own. */
+static const bench_settings all_settings[] = {
+    {"bare", 0},
+#if CCO_TARGET_ARCH == CCO_ARCH_x86
+#  if CCO_x86_ENABLE_EFLAGS_REGISTER_EXCHANGE
+    {"eflags", CCO_SETTINGS_x86_EXCHANGE_EFLAGS_REGISTER},
+#  endif
+#  if CCO_x86_ENABLE_SEGMENT_REGISTERS_EXCHANGE
+    {"segment", CCO_SETTINGS_x86_EXCHANGE_SEGMENT_REGISTERS},
+#  endif
+#  if CCO_x86_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    {"fp_control", CCO_SETTINGS_x86_EXCHANGE_FP_CONTROL_REGISTERS},
+#  endif
+#  if CCO_x86_ENABLE_FPU_MMX_REGISTERS_EXCHANGE || CCO_x86_ENABLE_SSE_REGISTERS_EXCHANGE
+    {"fxsr", CCO_SETTINGS_x86_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_EXCHANGE_SSE_REGISTERS},
+#  endif
+#elif CCO_TARGET_ARCH == CCO_ARCH_x86_64
+#  if CCO_x86_64_ENABLE_RFLAGS_REGISTER_EXCHANGE
+    {"rflags", CCO_SETTINGS_x86_64_EXCHANGE_RFLAGS_REGISTER},
+#  endif
+#  if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    {"fp_control", CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS},
+#  endif
+#  if CCO_x86_64_ENABLE_FPU_MMX_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE
+    {"fxsr", CCO_SETTINGS_x86_64_EXCHANGE_FPU_MMX_REGISTERS | CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS},
+#  endif
+#  if CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE
+    {"avx", CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS},
+#  endif
+#  if CCO_x86_64_ENABLE_AVX512_REGISTERS_EXCHANGE
+    {"avx512", CCO_SETTINGS_x86_64_EXCHANGE_AVX512_REGISTERS},
+#  endif
+#elif CCO_TARGET_ARCH == CCO_ARCH_ARM64
+#  if CCO_aarch64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    {"fp_control", CCO_SETTINGS_aarch64_EXCHANGE_FP_CONTROL_REGISTERS},
+#  endif
+#  if CCO_aarch64_ENABLE_SIMD_REGISTERS_EXCHANGE
+    {"simd", CCO_SETTINGS_aarch64_EXCHANGE_SIMD_REGISTERS},
+#  endif
+#endif
+};
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+now_cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+typedef struct bench_clock {
+    uint64_t ns;
+    uint64_t cycles;
+} bench_clock;
+
+static bench_clock
+bench_start(void)
+{
+    bench_clock clock = {now_ns(), now_cycles()};
+    return clock;
+}
+
+static void
+bench_report(const char* benchmark, const char* settings, unsigned long iterations, bench_clock start)
+{
+    const uint64_t cycles = now_cycles() - start.cycles;
+    const uint64_t ns     = now_ns() - start.ns;
+    printf("%s,%s,%lu,%.2f,%.2f\n", benchmark, settings, iterations, (double)ns / iterations, (double)cycles / iterations);
+    fflush(stdout);
+}
+
+static void
+yield_forever(void* arg)
+{
+    (void)arg;
+    for(;;) {
+        cco_yield(NULL);
+    }
+}
+
+static void
+yield_forever_fast(void* arg)
+{
+    (void)arg;
+    for(;;) {
+        cco_yield_fast(NULL);
+    }
+}
+
+static void
+return_immediately(void* arg)
+{
+    (void)arg;
+}
+
+static cco_scheduler* bench_scheduler;
+
+static void
+scheduler_yield_times(void* arg)
+{
+    for(unsigned long i = *(const unsigned long*)arg; i != 0; --i) {
+        cco_scheduler_yield(bench_scheduler);
+    }
+}
+
+/**
+ * @brief Runs SCHEDULER_COUNT coroutines taking turns through the ready queue of a scheduler: each operation is a
+ * cco_scheduler_yield() and the resumption of the next coroutine by cco_scheduler_run().
+ */
+static int
+bench_scheduler_yield(const bench_settings* settings, unsigned long iterations)
+{
+    static cco_coroutine* coroutines[SCHEDULER_COUNT];
+    const unsigned long   rounds   = iterations / SCHEDULER_COUNT;
+    int                   failures = (bench_scheduler = cco_scheduler_create()) == NULL;
+    for(size_t i = 0; i != SCHEDULER_COUNT; ++i) {
+        coroutines[i] = cco_coroutine_create(STACK_SIZE, &settings->settings);
+        if(!coroutines[i] || !cco_spawn(bench_scheduler, coroutines[i], scheduler_yield_times, (void*)&rounds)) {
+            failures = 1;
+        }
+    }
+    if(!failures) {
+        bench_clock clock = bench_start();
+        const size_t runs = cco_scheduler_run(bench_scheduler);
+        bench_report("scheduler_yield", settings->name, (unsigned long)runs, clock);
+    }
+    for(size_t i = 0; i != SCHEDULER_COUNT; ++i) {
+        cco_coroutine_destroy(coroutines[i]);
+    }
+    cco_scheduler_destroy(bench_scheduler);
+    return failures;
+}
+
+static int
+bench_coroutines(const bench_settings* settings, unsigned long iterations)
+{
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, &settings->settings);
+    if(!coroutine || !cco_coroutine_start(coroutine, yield_forever, NULL)) {
+        return 1;
+    }
+    bench_clock clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        cco_resume(coroutine);
+    }
+    bench_report("resume_yield", settings->name, iterations, clock);
+    cco_coroutine_destroy(coroutine);
+
+    coroutine = cco_coroutine_create(STACK_SIZE, &settings->settings);
+    if(!coroutine || cco_coroutine_start_fast(coroutine, yield_forever_fast, NULL) != CCO_OK) {
+        return 1;
+    }
+    clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        cco_resume_fast(coroutine);
+    }
+    bench_report("resume_yield_fast", settings->name, iterations, clock);
+    cco_coroutine_destroy(coroutine);
+
+    coroutine = cco_coroutine_create(STACK_SIZE, &settings->settings);
+    if(!coroutine) {
+        return 1;
+    }
+    clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        cco_coroutine_start(coroutine, return_immediately, NULL);
+    }
+    bench_report("start_return", settings->name, iterations, clock);
+    cco_coroutine_destroy(coroutine);
+
+    clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        coroutine = cco_coroutine_create(STACK_SIZE, &settings->settings);
+        if(!coroutine) {
+            return 1;
+        }
+        cco_coroutine_destroy(coroutine);
+    }
+    bench_report("create_destroy", settings->name, iterations, clock);
+
+    cco_pool* pool = cco_pool_create(&settings->settings, CCO_COROUTINE_FLAGS_DEFAULT, 1);
+    if(!pool) {
+        return 1;
+    }
+    clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        coroutine = cco_pool_acquire(pool, STACK_SIZE);
+        if(!coroutine) {
+            return 1;
+        }
+        cco_pool_release(pool, coroutine);
+    }
+    bench_report("pool_acquire_release", settings->name, iterations, clock);
+    cco_pool_destroy(pool);
+    return bench_scheduler_yield(settings, iterations);
+}
+
+static void
+touch_and_yield_forever(void* arg)
+{
+    volatile char frame[1024];
+    frame[0] = 0;
+    for(;;) {
+        cco_yield(arg);
+        frame[0] = frame[0] + 1;
+    }
+}
+
+/**
+ * @brief Resumes ROUND_ROBIN_COUNT coroutines in turn, each one touching its own stack, with the allocator in use: with
+ * every switch landing on a different stack, the cost is dominated by TLB and cache misses.
+ */
+static int
+bench_round_robin(const char* name, unsigned long iterations)
+{
+    static cco_coroutine* coroutines[ROUND_ROBIN_COUNT];
+    int                   failures = 0;
+    for(size_t i = 0; i != ROUND_ROBIN_COUNT; ++i) {
+        coroutines[i] = cco_coroutine_create(STACK_SIZE, NULL);
+        if(!coroutines[i] || !cco_coroutine_start(coroutines[i], touch_and_yield_forever, NULL)) {
+            failures = 1;
+        }
+    }
+    if(!failures) {
+        bench_clock clock = bench_start();
+        for(unsigned long i = 0; i != iterations; ++i) {
+            cco_resume(coroutines[i % ROUND_ROBIN_COUNT]);
+        }
+        bench_report("round_robin", name, iterations, clock);
+    }
+    for(size_t i = 0; i != ROUND_ROBIN_COUNT; ++i) {
+        cco_coroutine_destroy(coroutines[i]);
+    }
+    return failures;
+}
+
+static int
+bench_arena(unsigned long iterations)
+{
+    // the contexts take less than a page each for any settings
+    cco_arena* arena = cco_arena_create((size_t)ROUND_ROBIN_COUNT * (STACK_SIZE + 4096), STACK_SIZE, NULL);
+    if(!arena) {
+        return 1;
+    }
+    cco_set_thread_allocator(cco_arena_get_allocator(arena));
+    const int failures = bench_round_robin(cco_arena_uses_huge_pages(arena) ? "arena_huge" : "arena", iterations);
+    cco_set_thread_allocator(NULL);
+    cco_arena_destroy(arena);
+    return failures;
+}
+
+#if CCO_BENCH_BASELINES
+static ucontext_t swapcontext_main;
+static ucontext_t swapcontext_coroutine;
+
+static void
+swapcontext_yield_forever(void)
+{
+    for(;;) {
+        swapcontext(&swapcontext_coroutine, &swapcontext_main);
+    }
+}
+
+static int
+bench_swapcontext(unsigned long iterations)
+{
+    static char stack[STACK_SIZE];
+    if(getcontext(&swapcontext_coroutine) != 0) {
+        return 1;
+    }
+    swapcontext_coroutine.uc_stack.ss_sp   = stack;
+    swapcontext_coroutine.uc_stack.ss_size = sizeof(stack);
+    swapcontext_coroutine.uc_link          = &swapcontext_main;
+    makecontext(&swapcontext_coroutine, swapcontext_yield_forever, 0);
+    swapcontext(&swapcontext_main, &swapcontext_coroutine);
+
+    bench_clock clock = bench_start();
+    for(unsigned long i = 0; i != iterations; ++i) {
+        swapcontext(&swapcontext_main, &swapcontext_coroutine);
+    }
+    bench_report("resume_yield", "swapcontext", iterations, clock);
+    return 0;
+}
+
+/* Two threads taking turns: a round trip is the main thread handing over to the other one and waiting for it back. */
+static pthread_mutex_t condvar_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  condvar_cond  = PTHREAD_COND_INITIALIZER;
+static unsigned long   condvar_turn  = 0; /* odd when the other thread shall run */
+
+static void*
+condvar_partner(void* arg)
+{
+    const unsigned long iterations = *(const unsigned long*)arg;
+    pthread_mutex_lock(&condvar_mutex);
+    for(unsigned long i = 0; i != iterations; ++i) {
+        while(!(condvar_turn & 1)) {
+            pthread_cond_wait(&condvar_cond, &condvar_mutex);
+        }
+        ++condvar_turn;
+        pthread_cond_signal(&condvar_cond);
+    }
+    pthread_mutex_unlock(&condvar_mutex);
+    return NULL;
+}
+
+static int
+bench_condvar(unsigned long iterations)
+{
+    pthread_t partner;
+    if(pthread_create(&partner, NULL, condvar_partner, &iterations) != 0) {
+        return 1;
+    }
+    bench_clock clock = bench_start();
+    pthread_mutex_lock(&condvar_mutex);
+    for(unsigned long i = 0; i != iterations; ++i) {
+        ++condvar_turn;
+        pthread_cond_signal(&condvar_cond);
+        while(condvar_turn & 1) {
+            pthread_cond_wait(&condvar_cond, &condvar_mutex);
+        }
+    }
+    pthread_mutex_unlock(&condvar_mutex);
+    bench_report("resume_yield", "condvar", iterations, clock);
+    pthread_join(partner, NULL);
+    return 0;
+}
+#endif
+
+int
+main(int argc, char** argv)
+{
+    const unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    if(iterations == 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    printf("benchmark,settings,iterations,ns_per_op,cycles_per_op\n");
+    for(size_t i = 0; i != sizeof(all_settings) / sizeof(all_settings[0]); ++i) {
+        failures += bench_coroutines(&all_settings[i], iterations);
+    }
+    failures += bench_round_robin("heap", iterations);
+    failures += bench_arena(iterations);
+#if CCO_BENCH_BASELINES
+    failures += bench_swapcontext(iterations);
+    failures += bench_condvar(iterations);
+#endif
+    return failures != 0;
+}
@@ -31,9 +31,18 @@
 
 #include <cco.h>
 
+#include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <random>
+#include <string>
 #include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
 
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
@@ -277,32 +286,36 @@ TEST_CASE("Test 17: Retrieving coroutine's stack size", "[cco]")
     cco_coroutine_destroy(coroutine);
 }
 
+/** Size of the buffer Test 18 keeps on the stack of its coroutine. */
+static constexpr size_t TEST_18_BUFFER_SIZE = 4096;
+
+/** Fills the buffer of Test 18: called through a volatile pointer, so that it is neither inlined nor optimized out. */
+static void (*volatile test_18_fill)(volatile char*, size_t) = [](volatile char* buffer, size_t size) {
+    for(size_t i = 0; i != size; ++i) {
+        buffer[i] = char(i);
+    }
+};
+
 TEST_CASE("Test 18: Retrieving coroutine's stack usage", "[cco]")
 {
     cco_coroutine* coroutine = cco_coroutine_create(CCO_DEFAULT_STACK_SIZE, NULL);
     REQUIRE(coroutine != NULL);
-    cco_coroutine_start(
+    REQUIRE(cco_coroutine_start(
         coroutine,
         [](void*) {
-            volatile int32_t                       v = 0;
-            volatile int32_t                       values[32];
-            std::mt19937                           engine;
-            std::uniform_int_distribution<int32_t> dist;
-            for(int i = 0; i != sizeof(values) / sizeof(int32_t); ++i) {
-                values[i] = dist(engine);
-            }
-            for(int i = 0; i != sizeof(values) / sizeof(int32_t); ++i) {
-                v = v + values[i];
-            }
+            // still live while the coroutine is suspended
+            volatile char buffer[TEST_18_BUFFER_SIZE];
+            test_18_fill(buffer, sizeof(buffer));
             cco_suspend();
+            cco_return(reinterpret_cast<void*>(intptr_t(buffer[TEST_18_BUFFER_SIZE - 1])));
         },
         NULL
-    );
+    ));
 
-    REQUIRE(
-        cco_coroutine_get_stack_usage(coroutine)
-        > (sizeof(int32_t) * 32 + sizeof(int32_t) + sizeof(std::mt19937) + sizeof(std::uniform_int_distribution<int32_t>))
-    );
+    REQUIRE(cco_coroutine_get_stack_usage(coroutine) > TEST_18_BUFFER_SIZE);
+    REQUIRE(cco_coroutine_get_stack_usage(coroutine) < CCO_DEFAULT_STACK_SIZE);
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(intptr_t(char(TEST_18_BUFFER_SIZE - 1))));
     cco_coroutine_destroy(coroutine);
 }
 
@@ -417,4 +430,1514 @@ TEST_CASE("Test 22: Awaiting for 3 seconds on a result", "[cco]")
 
     REQUIRE(result == 1);
     cco_coroutine_destroy(coroutine);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test 23: Transfer values between two coroutines without going through the caller", "[cco]")
+{
+    struct Args {
+        cco_coroutine* ping;
+        cco_coroutine* pong;
+        int            hops;
+        int            result;
+    } args = {cco_coroutine_create(CCO_DEFAULT_STACK_SIZE, NULL), cco_coroutine_create(CCO_DEFAULT_STACK_SIZE, NULL), 0, 0};
+
+    REQUIRE(args.ping != NULL);
+    REQUIRE(args.pong != NULL);
+
+    REQUIRE(cco_coroutine_start(
+        args.ping,
+        [](void* arg) {
+            Args* args = reinterpret_cast<Args*>(arg);
+            cco_suspend();
+            int n = 0;
+            while(n < 10) {
+                int next = n + 1;
+                n        = *reinterpret_cast<int*>(cco_transfer(args->pong, &next));
+            }
+            args->result = n;
+        },
+        &args
+    ));
+    REQUIRE(cco_coroutine_get_state(args.ping) == CCO_COROUTINE_STATE_SUSPENDED);
+
+    REQUIRE(cco_coroutine_start(
+        args.pong,
+        [](void* arg) {
+            Args* args  = reinterpret_cast<Args*>(arg);
+            int*  value = reinterpret_cast<int*>(cco_transfer(args->ping, nullptr));
+            while(true) {
+                int reply = *value + 1;
+                ++args->hops;
+                value = reinterpret_cast<int*>(cco_transfer(args->ping, &reply));
+            }
+        },
+        &args
+    ));
+
+    // ping returned to the main context, which resumed the first coroutine of the chain
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(args.result == 10);
+    REQUIRE(args.hops == 5);
+    REQUIRE(cco_coroutine_get_state(args.ping) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_state(args.pong) == CCO_COROUTINE_STATE_SUSPENDED);
+    cco_coroutine_destroy(args.ping);
+    cco_coroutine_destroy(args.pong);
+}
+
+TEST_CASE("Test 24: Error when transferring from the main context or to a coroutine that is not suspended", "[cco]")
+{
+    cco_coroutine* coroutine = cco_coroutine_create(CCO_DEFAULT_STACK_SIZE, NULL);
+    cco_error      err       = CCO_OK;
+    REQUIRE(coroutine != NULL);
+
+    REQUIRE(cco_transfer(coroutine, nullptr) == nullptr);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+
+    REQUIRE(cco_coroutine_start(
+        coroutine,
+        [](void* err) {
+            cco_transfer(cco_this_coroutine(), nullptr);
+            *reinterpret_cast<cco_error*>(err) = cco_errno;
+        },
+        &err
+    ));
+    REQUIRE(err == CCO_ERROR_INVALID_ARGUMENT);
+    cco_coroutine_destroy(coroutine);
+}
+
+TEST_CASE("Test 25: Exchange values with a coroutine through cco_resume_with() and cco_yield_with()", "[cco]")
+{
+    cco_coroutine* coroutine = cco_coroutine_create(CCO_DEFAULT_STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+
+    // running sum of the values received, handed back at each step
+    REQUIRE(cco_coroutine_start(
+        coroutine,
+        [](void*) {
+            intptr_t sum = 0;
+            void*    in  = cco_yield_with(nullptr);
+            while(in) {
+                sum += reinterpret_cast<intptr_t>(in);
+                in = cco_yield_with(reinterpret_cast<void*>(sum));
+            }
+            cco_return(reinterpret_cast<void*>(-sum));
+        },
+        NULL
+    ));
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED);
+
+    for(intptr_t i = 1; i <= 4; ++i) {
+        REQUIRE(cco_resume_with(coroutine, reinterpret_cast<void*>(i)) == reinterpret_cast<void*>(i * (i + 1) / 2));
+    }
+    REQUIRE(cco_resume_with(coroutine, nullptr) == reinterpret_cast<void*>(-10));
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    REQUIRE(cco_resume_with(coroutine, nullptr) == nullptr);
+    REQUIRE(cco_errno == CCO_ERROR_NOT_SUSPENDED);
+    REQUIRE(cco_yield_with(nullptr) == nullptr);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    cco_coroutine_destroy(coroutine);
+}
+
+TEST_CASE("Test 26: Create and destroy coroutines of different sizes in any order", "[cco]")
+{
+    // exercises the reuse of released memory, whichever allocator the library is built with
+    std::mt19937   rng(26);
+    cco_coroutine* coroutines[32] = {};
+    for(int round = 0; round != 8; ++round) {
+        for(auto& coroutine : coroutines) {
+            if(!coroutine) {
+                coroutine = cco_coroutine_create(CCO_DEFAULT_STACK_SIZE << (rng() % 3), NULL);
+                REQUIRE(coroutine != NULL);
+                REQUIRE(cco_coroutine_start(
+                    coroutine, [](void* arg) { cco_yield(arg); }, coroutine
+                ));
+            }
+        }
+        for(auto& coroutine : coroutines) {
+            if(rng() % 2) {
+                cco_resume(coroutine);
+                REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+                cco_coroutine_destroy(coroutine);
+                coroutine = nullptr;
+            }
+        }
+    }
+    for(auto& coroutine : coroutines) {
+        if(coroutine) {
+            REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+            cco_coroutine_destroy(coroutine);
+        }
+    }
+}
+
+TEST_CASE("Test 27: Coroutines with guarded stacks only take the memory they touch", "[cco]")
+{
+    // 64 GiB of stacks in total: they can only be created if they are reserved rather than committed
+    static constexpr size_t STACK_SIZE = size_t(1) << 24;
+    cco_coroutine*          probe      = cco_coroutine_create(4096, NULL);
+    REQUIRE(probe != NULL);
+    cco_coroutine_get_stack_peak(probe);
+    const bool painted = cco_errno != CCO_ERROR_NOT_SUPPORTED;
+    cco_coroutine_destroy(probe);
+    if(painted) {
+        WARN("skipped: stack painting commits the whole stack");
+        return;
+    }
+    std::vector<cco_coroutine*> coroutines(4096);
+    for(auto& coroutine : coroutines) {
+        coroutine = cco_coroutine_create_with_flags(STACK_SIZE, NULL, CCO_COROUTINE_FLAG_GUARDED_STACK);
+        REQUIRE(coroutine != NULL);
+        REQUIRE(cco_coroutine_get_stack_size(coroutine) == STACK_SIZE);
+    }
+    for(auto& coroutine : coroutines) {
+        REQUIRE(cco_coroutine_start(
+            coroutine, [](void* arg) { cco_yield(arg); }, coroutine
+        ));
+        REQUIRE(cco_coroutine_get_stack_usage(coroutine) < STACK_SIZE / 16);
+        REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+    }
+    for(auto& coroutine : coroutines) {
+        cco_resume(coroutine);
+        REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+        cco_coroutine_destroy(coroutine);
+        REQUIRE(cco_errno == CCO_OK);
+    }
+
+    REQUIRE(cco_coroutine_create_with_flags(STACK_SIZE, NULL, CCO_COROUTINE_FLAG_TRIM_STACK << 1) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+}
+
+TEST_CASE("Test 28: Recycle coroutines through a pool", "[cco]")
+{
+    cco_pool* pool = cco_pool_create(NULL, CCO_COROUTINE_FLAGS_DEFAULT, 2);
+    REQUIRE(pool != NULL);
+
+    // rounded up to the size class, and reused once released
+    cco_coroutine* first = cco_pool_acquire(pool, 5000);
+    REQUIRE(first != NULL);
+    REQUIRE(cco_coroutine_get_stack_size(first) == CCO_POOL_CLASS_STACK_SIZE(1));
+    REQUIRE(cco_coroutine_start(
+        first,
+        [](void* arg) {
+            volatile char frame[8192];
+            frame[0] = 1;
+            cco_yield(frame[0] == 1 ? arg : nullptr);
+        },
+        first
+    ));
+    REQUIRE(cco_coroutine_get_state(first) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(cco_coroutine_get_return_value(first) == first);
+    cco_pool_release(pool, first);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_pool_acquire(pool, CCO_POOL_CLASS_STACK_SIZE(1)) == first);
+    // nothing is left of the previous run
+    REQUIRE(cco_coroutine_get_state(first) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_return_value(first) == NULL);
+    const size_t peak = cco_coroutine_get_stack_peak(first);
+    if(cco_errno != CCO_ERROR_NOT_SUPPORTED) {
+        REQUIRE(peak < 8192);
+    }
+
+    int  value = 0;
+    auto set   = [](void* arg) { *reinterpret_cast<int*>(arg) = 28; };
+    REQUIRE(cco_coroutine_start(first, set, &value));
+    REQUIRE(value == 28);
+
+    // at most max_cached coroutines per class, the others are destroyed
+    cco_coroutine* others[3];
+    for(auto& other : others) {
+        other = cco_pool_acquire(pool, CCO_POOL_CLASS_STACK_SIZE(1));
+        REQUIRE(other != NULL);
+        REQUIRE(other != first);
+    }
+    cco_pool_release(pool, first);
+    for(auto& other : others) {
+        cco_pool_release(pool, other);
+    }
+    REQUIRE(cco_pool_trim(pool, 1) == 1);
+    REQUIRE(cco_pool_trim(pool, 1) == 0);
+
+    // larger than the largest class: created with the exact size
+    cco_coroutine* large = cco_pool_acquire(pool, CCO_POOL_CLASS_STACK_SIZE(CCO_POOL_SIZE_CLASSES - 1) + 1);
+    REQUIRE(large != NULL);
+    REQUIRE(cco_coroutine_get_stack_size(large) == CCO_POOL_CLASS_STACK_SIZE(CCO_POOL_SIZE_CLASSES - 1) + 1);
+    cco_pool_release(pool, large);
+
+    REQUIRE(cco_pool_acquire(pool, 0) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    cco_pool_destroy(pool);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+TEST_CASE("Test 29: Coroutines on a shared stack keep their frames across switches", "[cco]")
+{
+    cco_shared_stack* stack = cco_shared_stack_create(CCO_DEFAULT_STACK_SIZE * 4);
+    REQUIRE(stack != NULL);
+
+    // each coroutine fills a buffer on its stack, and checks it after every switch
+    auto fill_and_check = [](void* arg) {
+        const intptr_t seed = reinterpret_cast<intptr_t>(arg);
+        volatile int   buffer[256];
+        for(int i = 0; i != 256; ++i) {
+            buffer[i] = int(seed * 1000 + i);
+        }
+        for(int round = 0; round != 4; ++round) {
+            cco_yield(nullptr);
+            for(int i = 0; i != 256; ++i) {
+                if(buffer[i] != int(seed * 1000 + i)) {
+                    cco_return(nullptr);
+                }
+            }
+        }
+        cco_return(arg);
+    };
+
+    cco_coroutine* coroutines[8];
+    for(intptr_t i = 0; i != 8; ++i) {
+        coroutines[i] = cco_coroutine_create_shared(stack, NULL);
+        REQUIRE(coroutines[i] != NULL);
+        REQUIRE(cco_coroutine_start(coroutines[i], fill_and_check, reinterpret_cast<void*>(i + 1)));
+        REQUIRE(cco_coroutine_get_stack_usage(coroutines[i]) > 256 * sizeof(int));
+    }
+    for(int round = 0; round != 4; ++round) {
+        for(auto coroutine : coroutines) {
+            cco_resume(coroutine);
+            REQUIRE(cco_errno == CCO_OK);
+        }
+    }
+    for(intptr_t i = 0; i != 8; ++i) {
+        REQUIRE(cco_coroutine_get_state(coroutines[i]) == CCO_COROUTINE_STATE_UNSCHEDULED);
+        REQUIRE(cco_coroutine_get_return_value(coroutines[i]) == reinterpret_cast<void*>(i + 1));
+    }
+
+    // a coroutine on the shared stack cannot switch to another one on the same stack
+    struct same_stack_args {
+        cco_coroutine* other;
+        cco_error      err;
+    } args = {coroutines[1], CCO_OK};
+    REQUIRE(cco_coroutine_start(
+        coroutines[0],
+        [](void* arg) {
+            auto args = reinterpret_cast<same_stack_args*>(arg);
+            cco_coroutine_start(args->other, [](void*) {}, nullptr);
+            args->err = cco_errno;
+        },
+        &args
+    ));
+    REQUIRE(args.err == CCO_ERROR_INVALID_CONTEXT);
+
+    for(auto coroutine : coroutines) {
+        cco_coroutine_destroy(coroutine);
+    }
+    cco_shared_stack_destroy(stack);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+TEST_CASE("Test 30: the stack peak covers frames that have already been popped", "[cco]")
+{
+    cco_coroutine* coroutine = cco_coroutine_create(65536, NULL);
+    REQUIRE(coroutine != NULL);
+
+    REQUIRE(cco_coroutine_get_stack_peak(NULL) == 0);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+
+    REQUIRE(cco_coroutine_start(
+        coroutine,
+        [](void*) {
+            {
+                volatile char buffer[16384];
+                for(size_t i = 0; i != sizeof(buffer); ++i) {
+                    buffer[i] = char(i);
+                }
+            }
+            cco_yield(nullptr);
+        },
+        nullptr
+    ));
+    const size_t usage = cco_coroutine_get_stack_usage(coroutine);
+    const size_t peak  = cco_coroutine_get_stack_peak(coroutine);
+    if(cco_errno != CCO_ERROR_NOT_SUPPORTED) {
+        // the library was built with STACK_PAINTING
+        REQUIRE(cco_errno == CCO_OK);
+        REQUIRE(peak >= 16384);
+        REQUIRE(peak > usage);
+        REQUIRE(peak <= 65536);
+    }
+    else {
+        REQUIRE(peak == 0);
+    }
+    cco_resume(coroutine);
+    cco_coroutine_destroy(coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+TEST_CASE("Test 31: Coroutines take their memory from the allocator in use", "[cco]")
+{
+    struct counters {
+        int blocks, contexts, stacks;
+    } live = {0, 0, 0};
+
+    cco_allocator allocator = {
+        [](void* user_data, size_t size) {
+            ++reinterpret_cast<counters*>(user_data)->blocks;
+            return malloc(size);
+        },
+        [](void* user_data, void* ptr, size_t) {
+            --reinterpret_cast<counters*>(user_data)->blocks;
+            free(ptr);
+        },
+        [](void* user_data, size_t size, size_t alignment) {
+            ++reinterpret_cast<counters*>(user_data)->contexts;
+            void* ptr = nullptr;
+            return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+        },
+        [](void* user_data, void* ptr, size_t) {
+            --reinterpret_cast<counters*>(user_data)->contexts;
+            free(ptr);
+        },
+        [](void* user_data, size_t size) {
+            ++reinterpret_cast<counters*>(user_data)->stacks;
+            return malloc(size);
+        },
+        [](void* user_data, void* ptr, size_t) {
+            --reinterpret_cast<counters*>(user_data)->stacks;
+            free(ptr);
+        },
+        &live,
+    };
+
+    cco_allocator incomplete = allocator;
+    incomplete.allocate_stack = nullptr;
+    cco_set_thread_allocator(&incomplete);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_get_allocator() == NULL);
+
+    cco_set_thread_allocator(&allocator);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_get_allocator() == &allocator);
+
+    cco_coroutine* coroutine = cco_coroutine_create(16384, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(live.contexts == 1);
+    REQUIRE(live.stacks == 1);
+    REQUIRE(cco_coroutine_start(coroutine, [](void* arg) { cco_yield(arg); }, coroutine));
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+    cco_resume(coroutine);
+
+    cco_shared_stack* stack  = cco_shared_stack_create(16384);
+    cco_coroutine*    shared = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(shared != NULL);
+    REQUIRE(live.blocks == 1);
+    REQUIRE(live.contexts == 2);
+    REQUIRE(live.stacks == 2);
+
+    cco_pool* pool = cco_pool_create(NULL, CCO_COROUTINE_FLAGS_DEFAULT, 1);
+    REQUIRE(live.blocks == 2);
+    // the allocator of the thread does not matter any more: the pool and the objects keep their own
+    cco_set_thread_allocator(NULL);
+    cco_pool_release(pool, cco_pool_acquire(pool, 4096));
+    REQUIRE(live.contexts == 3);
+    REQUIRE(live.stacks == 3);
+
+    cco_pool_destroy(pool);
+    cco_coroutine_destroy(shared);
+    cco_shared_stack_destroy(stack);
+    cco_coroutine_destroy(coroutine);
+    REQUIRE(live.blocks == 0);
+    REQUIRE(live.contexts == 0);
+    REQUIRE(live.stacks == 0);
+}
+
+TEST_CASE("Test 32: Create coroutines in a buffer provided by the caller", "[cco]")
+{
+    static constexpr size_t STACK_SIZE   = 16384;
+    static constexpr size_t STORAGE_SIZE = CCO_COROUTINE_STORAGE_SIZE(STACK_SIZE, ~0u);
+    // one more byte, to misalign the buffer on purpose
+    static unsigned char storage[STORAGE_SIZE + 1];
+    unsigned char* const buffer = storage + 1;
+
+    REQUIRE(cco_coroutine_create_in(NULL, STORAGE_SIZE, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_coroutine_create_in(buffer, 64, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+
+    // room for the control block and the context, but not for a stack: the frames would be written below the buffer
+    static const cco_architecture_specific_settings no_registers = 0;
+    REQUIRE(cco_coroutine_create_in(buffer, CCO_COROUTINE_STORAGE_SIZE(0, 0), &no_registers) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_coroutine_create(CCO_MIN_STACK_SIZE - 1, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    cco_coroutine* smallest = cco_coroutine_create_in(buffer, CCO_COROUTINE_STORAGE_SIZE(CCO_MIN_STACK_SIZE, 0), &no_registers);
+    REQUIRE(smallest != NULL);
+    REQUIRE(cco_coroutine_get_stack_size(smallest) >= CCO_MIN_STACK_SIZE);
+    REQUIRE(cco_coroutine_start(smallest, [](void* arg) { cco_yield(arg); }, smallest));
+    REQUIRE(cco_coroutine_get_return_value(smallest) == smallest);
+    cco_resume(smallest);
+    REQUIRE(cco_coroutine_get_state(smallest) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_coroutine_destroy(smallest);
+
+    for(int round = 0; round != 2; ++round) {
+        cco_coroutine* coroutine = cco_coroutine_create_in(buffer, STORAGE_SIZE, NULL);
+        REQUIRE(coroutine != NULL);
+        REQUIRE(reinterpret_cast<unsigned char*>(coroutine) > buffer);
+        REQUIRE(reinterpret_cast<unsigned char*>(coroutine) < buffer + STORAGE_SIZE);
+        REQUIRE(cco_coroutine_get_stack_size(coroutine) >= STACK_SIZE);
+
+        REQUIRE(cco_coroutine_start(
+            coroutine,
+            [](void* arg) {
+                volatile char frame[4096];
+                frame[0] = 1;
+                cco_yield(arg);
+                cco_return(reinterpret_cast<void*>(intptr_t(frame[0]) + reinterpret_cast<intptr_t>(arg)));
+            },
+            reinterpret_cast<void*>(intptr_t(round))
+        ));
+        REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(intptr_t(round)));
+        cco_resume(coroutine);
+        REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(intptr_t(round + 1)));
+        cco_coroutine_destroy(coroutine);
+        REQUIRE(cco_errno == CCO_OK);
+    }
+}
+
+TEST_CASE("Test 33: Carve coroutines out of a huge-page arena", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+    static constexpr size_t CAPACITY   = size_t(4) << 20;
+
+    REQUIRE(cco_arena_create(CAPACITY, 0, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+
+    cco_arena* arena = cco_arena_create(CAPACITY, STACK_SIZE, NULL);
+    REQUIRE(arena != NULL);
+    // either outcome is fine, huge pages depend on the configuration of the system
+    cco_arena_uses_huge_pages(arena);
+    REQUIRE(cco_errno == CCO_OK);
+    cco_set_thread_allocator(cco_arena_get_allocator(arena));
+    REQUIRE(cco_errno == CCO_OK);
+
+    REQUIRE(cco_coroutine_create(STACK_SIZE + 1, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_NO_MEMORY);
+
+    // fill the arena up, twice: the second time from the free lists
+    size_t created[2];
+    for(size_t& count : created) {
+        std::vector<cco_coroutine*> coroutines;
+        for(cco_coroutine* coroutine; (coroutine = cco_coroutine_create(STACK_SIZE, NULL)) != NULL;) {
+            coroutines.push_back(coroutine);
+        }
+        REQUIRE(cco_errno == CCO_ERROR_NO_MEMORY);
+        count = coroutines.size();
+        REQUIRE(count > CAPACITY / (2 * STACK_SIZE));
+        REQUIRE(count <= CAPACITY / STACK_SIZE);
+
+        for(auto coroutine : coroutines) {
+            REQUIRE(cco_coroutine_start(
+                coroutine,
+                [](void* arg) {
+                    // touch the far end of the frame, half the stack deep
+                    volatile char frame[STACK_SIZE / 2];
+                    frame[0] = 0;
+                    cco_yield(frame[0] == 0 ? arg : nullptr);
+                },
+                coroutine
+            ));
+        }
+        for(auto coroutine : coroutines) {
+            REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+            cco_resume(coroutine);
+            cco_coroutine_destroy(coroutine);
+        }
+    }
+    REQUIRE(created[0] == created[1]);
+
+    cco_set_thread_allocator(NULL);
+    cco_arena_destroy(arena);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+/** Address of the lowest byte touched by the deep frame of Test 34. */
+static volatile uintptr_t test_34_deepest;
+
+#if defined(__linux__)
+/** Number of pages of the deep frame of Test 34 which are resident. */
+static size_t
+test_34_resident_pages(void)
+{
+    const uintptr_t page  = uintptr_t(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = (test_34_deepest + page - 1) & ~(page - 1);
+    unsigned char   residency[16];
+    size_t          resident = 0;
+    REQUIRE(mincore(reinterpret_cast<void*>(begin), sizeof(residency) * page, residency) == 0);
+    for(unsigned char pages : residency) {
+        resident += pages & 1;
+    }
+    return resident;
+}
+#endif
+
+TEST_CASE("Test 34: Trim the stack of idle coroutines", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 262144;
+
+    // goes 128 KiB deep, comes back, and checks its own frame survives the trim while it is suspended
+    auto deep_then_idle = [](void* arg) {
+        volatile char frame[256];
+        for(size_t i = 0; i != sizeof(frame); ++i) {
+            frame[i] = char(i);
+        }
+        auto dig = [](void*) {
+            volatile char deep[131072];
+            for(size_t i = 0; i < sizeof(deep); i += 64) {
+                deep[i] = 1;
+            }
+            test_34_deepest = reinterpret_cast<uintptr_t>(deep);
+        };
+        reinterpret_cast<void (*)(void*)>(+dig)(nullptr);
+        REQUIRE(cco_coroutine_trim_stack(cco_this_coroutine()) == 0);
+        REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+        cco_yield(arg);
+        for(size_t i = 0; i != sizeof(frame); ++i) {
+            if(frame[i] != char(i)) {
+                cco_return(nullptr);
+            }
+        }
+        reinterpret_cast<void (*)(void*)>(+dig)(nullptr);
+        cco_return(arg);
+    };
+
+    REQUIRE(cco_coroutine_trim_stack(NULL) == 0);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+
+    cco_coroutine* coroutine = cco_coroutine_create_with_flags(STACK_SIZE, NULL, CCO_COROUTINE_FLAGS_NONE);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, deep_then_idle, coroutine));
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED);
+#if defined(__linux__)
+    REQUIRE(test_34_resident_pages() == 16);
+#endif
+    REQUIRE(cco_coroutine_trim_stack(coroutine) >= 131072 - 8192);
+    REQUIRE(cco_errno == CCO_OK);
+#if defined(__linux__)
+    REQUIRE(test_34_resident_pages() == 0);
+#endif
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+    REQUIRE(cco_coroutine_trim_stack(coroutine) >= STACK_SIZE - 8192);
+    cco_coroutine_destroy(coroutine);
+
+    // trimmed on return already
+    coroutine = cco_coroutine_create_with_flags(STACK_SIZE, NULL, CCO_COROUTINE_FLAG_TRIM_STACK);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, deep_then_idle, coroutine));
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+#if defined(__linux__)
+    REQUIRE(test_34_resident_pages() == 0);
+#endif
+    cco_coroutine_destroy(coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+TEST_CASE("Test 35: Run stack-hungry calls on the big stack of the thread", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 1024;
+
+    struct call_results {
+        char                buffer[64];
+        void*               nested;
+        cco_error           release;
+        cco_coroutine*      caller;
+        cco_coroutine_state state;
+    };
+
+    // far more than the stack of the coroutine, and than a few KiB of printf
+    auto format = [](void* arg) -> void* {
+        call_results* results = static_cast<call_results*>(arg);
+        volatile char deep[65536];
+        for(size_t i = 0; i < sizeof(deep); i += 64) {
+            deep[i] = 1;
+        }
+        snprintf(results->buffer, sizeof(results->buffer), "%s %d %.3f", "big", 42 + deep[0], 3.14159);
+        cco_release_big_stack();
+        results->release = cco_errno;
+        results->caller  = cco_this_coroutine();
+        results->state   = cco_coroutine_get_state(results->caller);
+        results->nested  = cco_call_on_big_stack([](void* nested) -> void* { return nested; }, results);
+        return results->buffer;
+    };
+    auto small = [](void* arg) {
+        void* (*call)(void*) = *static_cast<void* (**)(void*)>(arg);
+        call_results results;
+        for(;;) {
+            cco_yield(cco_call_on_big_stack(call, &results) == results.buffer ? &results : nullptr);
+        }
+    };
+
+    REQUIRE(cco_call_on_big_stack(NULL, NULL) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+
+    // the first call maps the big stack, which takes more than STACK_SIZE
+    call_results results;
+    REQUIRE(cco_call_on_big_stack(+format, &results) == results.buffer);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(std::string(results.buffer) == "big 43 3.142");
+    REQUIRE(results.caller == NULL);
+
+    void* (*call)(void*)     = +format;
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, +small, &call));
+    for(int i = 0; i != 3; ++i) {
+        cco_resume(coroutine);
+        REQUIRE(cco_errno == CCO_OK);
+        call_results* inner = static_cast<call_results*>(cco_coroutine_get_return_value(coroutine));
+        REQUIRE(inner != NULL);
+        REQUIRE(std::string(inner->buffer) == "big 43 3.142");
+        REQUIRE(inner->nested == inner);
+        REQUIRE(inner->release == CCO_ERROR_INVALID_CONTEXT);
+        REQUIRE(inner->caller == coroutine);
+        REQUIRE(inner->state == CCO_COROUTINE_STATE_RUNNING);
+    }
+    cco_coroutine_destroy(coroutine);
+
+    cco_release_big_stack();
+    REQUIRE(cco_errno == CCO_OK);
+    cco_release_big_stack();
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_call_on_big_stack(+format, &results) == results.buffer);
+    REQUIRE(cco_errno == CCO_OK);
+}
+
+TEST_CASE("Test 36: The fast API returns the error and leaves errno untouched", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    auto counter = [](void* arg) {
+        REQUIRE(cco_this_coroutine_fast() == arg);
+        for(uintptr_t i = 1; i != 4; ++i) {
+            REQUIRE(cco_yield_fast(reinterpret_cast<void*>(i)) == CCO_OK);
+        }
+        // resumed with a value by cco_resume_with()
+        REQUIRE(cco_yield_with(reinterpret_cast<void*>(uintptr_t(4))) == reinterpret_cast<void*>(uintptr_t(40)));
+        REQUIRE(cco_suspend_fast() == CCO_OK);
+        cco_return_fast(arg);
+    };
+
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    // anything but CCO_OK, to tell whether errno is written
+    cco_resume(NULL);
+    REQUIRE(cco_this_coroutine_fast() == NULL);
+    REQUIRE(cco_coroutine_start_fast(coroutine, +counter, coroutine) == CCO_OK);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(uintptr_t(1)));
+    for(uintptr_t i = 2; i != 4; ++i) {
+        cco_resume(NULL);
+        REQUIRE(cco_resume_fast(coroutine) == CCO_OK);
+        REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+        REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(i));
+    }
+    // suspended in cco_yield_fast(): whatever it is resumed with, it gets CCO_OK
+    REQUIRE(cco_resume_with(coroutine, reinterpret_cast<void*>(uintptr_t(30))) == reinterpret_cast<void*>(uintptr_t(4)));
+    // suspended in cco_yield_with(): whatever it hands over, cco_resume_fast() gets CCO_OK
+    REQUIRE(cco_resume_with(coroutine, reinterpret_cast<void*>(uintptr_t(40))) == NULL);
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED);
+    cco_resume(NULL);
+    REQUIRE(cco_resume_fast(coroutine) == CCO_OK);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == coroutine);
+
+    // a hand-off between two coroutines, back and forth
+    static cco_coroutine* pair[2];
+    auto ping = [](void* arg) {
+        uintptr_t count = 0;
+        cco_yield_fast(NULL);
+        for(;;) {
+            ++count;
+            cco_transfer_fast(pair[1], reinterpret_cast<void*>(count));
+            if(count == 3) {
+                cco_return_fast(arg);
+            }
+        }
+    };
+    auto pong = [](void* arg) {
+        cco_yield_fast(NULL);
+        for(;;) {
+            cco_transfer_fast(pair[0], arg);
+        }
+    };
+    pair[0] = coroutine;
+    pair[1] = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(pair[1] != NULL);
+    cco_resume(NULL);
+    REQUIRE(cco_coroutine_start_fast(pair[0], +ping, pair[0]) == CCO_OK);
+    REQUIRE(cco_coroutine_start_fast(pair[1], +pong, pair[1]) == CCO_OK);
+    REQUIRE(cco_resume_fast(pair[0]) == CCO_OK);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_coroutine_get_state(pair[0]) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_return_value(pair[0]) == pair[0]);
+    REQUIRE(cco_coroutine_get_state(pair[1]) == CCO_COROUTINE_STATE_SUSPENDED);
+
+#if CCO_DEBUG
+    // the checks of the debug builds
+    cco_resume(NULL);
+    REQUIRE(cco_resume_fast(NULL) == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_resume_fast(pair[0]) == CCO_ERROR_NOT_SUSPENDED);
+    REQUIRE(cco_coroutine_start_fast(pair[1], +pong, NULL) == CCO_ERROR_SCHEDULED);
+    REQUIRE(cco_coroutine_start_fast(pair[0], NULL, NULL) == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(cco_yield_fast(NULL) == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_suspend_fast() == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_return_fast(NULL) == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_transfer_fast(pair[1], NULL) == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+#endif
+    cco_coroutine_destroy(pair[0]);
+    cco_coroutine_destroy(pair[1]);
+}
+
+#if CCO_INLINE_API
+TEST_CASE("Test 37: The inline queries agree with the exported ones", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    auto body = [](void* arg) {
+        REQUIRE(cco_this_coroutine_inline() == arg);
+        REQUIRE(cco_coroutine_get_state_inline(static_cast<cco_coroutine*>(arg)) == CCO_COROUTINE_STATE_RUNNING);
+        cco_yield(arg);
+        cco_return(NULL);
+    };
+
+    REQUIRE(cco_this_coroutine_inline() == NULL);
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_get_state_inline(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_coroutine_start(coroutine, +body, coroutine);
+    REQUIRE(cco_coroutine_get_state_inline(coroutine) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(cco_coroutine_get_state_inline(coroutine) == cco_coroutine_get_state(coroutine));
+    REQUIRE(cco_coroutine_get_return_value_inline(coroutine) == coroutine);
+    REQUIRE(cco_coroutine_get_return_value_inline(coroutine) == cco_coroutine_get_return_value(coroutine));
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_state_inline(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_return_value_inline(coroutine) == NULL);
+    REQUIRE(cco_this_coroutine_inline() == NULL);
+    cco_coroutine_destroy(coroutine);
+}
+#endif
+
+TEST_CASE("Test 38: Coroutines run on threads other than the one that loads the library", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    // Catch2 is not thread-safe: the threads record what they see, the main thread checks it
+    struct observations {
+        bool                errno_valid = false;
+        bool                outside     = false;
+        bool                inside      = false;
+        cco_error           error       = CCO_ERROR_NOT_SUPPORTED;
+        uintptr_t           sum         = 0;
+        cco_coroutine_state final_state = CCO_COROUTINE_STATE_NONE;
+    };
+    auto counter = [](void* arg) {
+        auto* seen   = static_cast<observations*>(arg);
+        seen->inside = cco_this_coroutine() != NULL;
+        for(uintptr_t i = 1; i != 4; ++i) {
+            cco_yield(reinterpret_cast<void*>(i));
+        }
+    };
+
+    // set up on its first creation of a coroutine
+    observations created;
+    std::thread([&created, counter] {
+        created.errno_valid      = cco_errno_ptr() != NULL;
+        created.outside          = cco_this_coroutine() == NULL;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        cco_coroutine_start(coroutine, +counter, &created);
+        while(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED) {
+            created.sum += reinterpret_cast<uintptr_t>(cco_coroutine_get_return_value(coroutine));
+            cco_resume(coroutine);
+        }
+        created.error       = cco_errno;
+        created.final_state = cco_coroutine_get_state(coroutine);
+        cco_coroutine_destroy(coroutine);
+    }).join();
+    REQUIRE(created.errno_valid);
+    REQUIRE(created.outside);
+    REQUIRE(created.inside);
+    REQUIRE(created.sum == 6);
+    REQUIRE(created.error == CCO_OK);
+    REQUIRE(created.final_state == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // set up explicitly, to run a coroutine handed over by the main thread
+    observations handed;
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, +counter, &handed));
+    std::thread([&handed, coroutine] {
+        cco_thread_init();
+        handed.error = cco_errno;
+        while(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED) {
+            handed.sum += reinterpret_cast<uintptr_t>(cco_coroutine_get_return_value(coroutine));
+            cco_resume(coroutine);
+        }
+        handed.final_state = cco_coroutine_get_state(coroutine);
+    }).join();
+    REQUIRE(handed.inside);
+    REQUIRE(handed.sum == 6);
+    REQUIRE(handed.error == CCO_OK);
+    REQUIRE(handed.final_state == CCO_COROUTINE_STATE_UNSCHEDULED);
+    // the main thread is unaffected
+    REQUIRE(cco_this_coroutine() == NULL);
+    cco_coroutine_destroy(coroutine);
+}
+
+TEST_CASE("Test 39: A suspended coroutine is handed over between threads", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+    static constexpr int    ROUNDS     = 6;
+
+    auto body = [](void*) {
+        uintptr_t count = 0; // on the stack of the coroutine, which moves with it
+        REQUIRE(!cco_coroutine_release(cco_this_coroutine()));
+        REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+        for(int i = 0; i != ROUNDS; ++i) {
+            ++count;
+            cco_yield(NULL);
+        }
+        cco_return(reinterpret_cast<void*>(count));
+    };
+
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(!cco_coroutine_release(NULL));
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    REQUIRE(!cco_coroutine_acquire(coroutine));
+    REQUIRE(cco_errno == CCO_ERROR_NOT_RELEASED);
+    REQUIRE(cco_coroutine_release(coroutine));
+    REQUIRE(cco_coroutine_acquire(coroutine));
+    REQUIRE(!cco_coroutine_acquire(coroutine));
+    REQUIRE(cco_errno == CCO_ERROR_NOT_RELEASED);
+
+    // the threads take turns, each resuming the coroutine once: the hand-over is their only synchronization
+    REQUIRE(cco_coroutine_start(coroutine, +body, NULL));
+    REQUIRE(cco_coroutine_release(coroutine));
+    // owned by whoever owns the coroutine; the thread identity is taken outside of it, see cco_coroutine_release()
+    std::thread::id  resumed_by[ROUNDS];
+    int              resumes = 0;
+    std::atomic<int> turn{1};
+
+    auto play = [coroutine, &turn, &resumed_by, &resumes](int me) {
+        cco_thread_init();
+        for(int current; (current = turn.load(std::memory_order_relaxed)) != -1;) {
+            if(current != me || !cco_coroutine_acquire(coroutine)) {
+                std::this_thread::yield();
+                continue;
+            }
+            resumed_by[resumes++] = std::this_thread::get_id();
+            cco_resume(coroutine);
+            const bool done = cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED;
+            cco_coroutine_release(coroutine);
+            turn.store(done ? -1 : 1 - me, std::memory_order_relaxed);
+        }
+    };
+    std::thread worker(play, 1);
+    const std::thread::id worker_id = worker.get_id();
+    play(0);
+    worker.join();
+    REQUIRE(cco_coroutine_acquire(coroutine));
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(uintptr_t(ROUNDS)));
+    REQUIRE(resumes == ROUNDS);
+    for(int i = 0; i != ROUNDS; ++i) {
+        REQUIRE(resumed_by[i] == (i % 2 ? std::this_thread::get_id() : worker_id));
+    }
+    cco_coroutine_destroy(coroutine);
+}
+
+TEST_CASE("Test 40: The scheduler runs the ready coroutines in FIFO order", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+    static constexpr int    COUNT      = 3;
+    static constexpr int    ROUNDS     = 3;
+
+    static cco_scheduler*   scheduler;
+    static std::vector<int> log;
+
+    auto round_robin = [](void* arg) {
+        for(int i = 0; i != ROUNDS; ++i) {
+            log.push_back(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+            cco_scheduler_yield(scheduler);
+        }
+    };
+    auto parked = [](void* arg) {
+        log.push_back(-1);
+        cco_await_with(NULL, cco_scheduler_park, NULL);
+        log.push_back(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+    };
+
+    scheduler = cco_scheduler_create();
+    REQUIRE(scheduler != NULL);
+    REQUIRE(cco_scheduler_run(scheduler) == 0);
+    cco_scheduler_yield(scheduler);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+
+    cco_coroutine* coroutines[COUNT];
+    for(int i = 0; i != COUNT; ++i) {
+        coroutines[i] = cco_coroutine_create(STACK_SIZE, NULL);
+        REQUIRE(coroutines[i] != NULL);
+        REQUIRE(cco_spawn(scheduler, coroutines[i], +round_robin, reinterpret_cast<void*>(intptr_t(i))));
+    }
+    // started only once the scheduler runs
+    REQUIRE(log.empty());
+    REQUIRE(cco_scheduler_run(scheduler) == COUNT * (ROUNDS + 1));
+    REQUIRE(log.size() == COUNT * ROUNDS);
+    for(size_t i = 0; i != log.size(); ++i) {
+        REQUIRE(log[i] == static_cast<int>(i % COUNT));
+    }
+    for(int i = 0; i != COUNT; ++i) {
+        REQUIRE(cco_coroutine_get_state(coroutines[i]) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    }
+
+    // parked until woken up
+    log.clear();
+    REQUIRE(!cco_spawn(scheduler, coroutines[0], NULL, NULL));
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_ARGUMENT);
+    cco_scheduler_wake(scheduler, coroutines[0]);
+    REQUIRE(cco_errno == CCO_ERROR_NOT_SUSPENDED);
+    REQUIRE(cco_spawn(scheduler, coroutines[0], +parked, reinterpret_cast<void*>(intptr_t(42))));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1});
+    REQUIRE(cco_coroutine_get_state(coroutines[0]) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(!cco_spawn(scheduler, coroutines[0], +parked, NULL));
+    REQUIRE(cco_errno == CCO_ERROR_SCHEDULED);
+    cco_scheduler_wake(scheduler, coroutines[0]);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1, 42});
+    REQUIRE(cco_coroutine_get_state(coroutines[0]) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    for(int i = 0; i != COUNT; ++i) {
+        cco_coroutine_destroy(coroutines[i]);
+    }
+    cco_scheduler_destroy(scheduler);
+}
+
+TEST_CASE("Test 41: Switches from a call on the big stack are rejected", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    static cco_coroutine* other;
+    static cco_coroutine* unscheduled;
+    static cco_error      errors[8];
+    auto idle = [](void*) {
+        cco_yield(NULL);
+    };
+    auto on_big_stack = [](void*) -> void* {
+        cco_yield(NULL);
+        errors[0] = cco_errno;
+        cco_suspend();
+        errors[1] = cco_errno;
+        cco_resume(other);
+        errors[2] = cco_errno;
+        cco_transfer(other, NULL);
+        errors[3] = cco_errno;
+        cco_return(NULL);
+        errors[4] = cco_errno;
+        cco_coroutine_start(unscheduled, [](void*) {}, NULL);
+        errors[5] = cco_errno;
+        cco_await_with(NULL, cco_scheduler_park, NULL);
+        errors[6] = cco_errno;
+        cco_await(NULL);
+        errors[7] = cco_errno;
+        return &errors;
+    };
+    auto body = [](void* arg) {
+        cco_yield(cco_call_on_big_stack(*static_cast<void* (**)(void*)>(arg), NULL));
+    };
+    void* (*call)(void*) = +on_big_stack;
+
+    // nor can the main context await
+    cco_await_with(NULL, cco_scheduler_park, NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    cco_await(NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+
+    other = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(other != NULL);
+    REQUIRE(cco_coroutine_start(other, +idle, NULL));
+    unscheduled = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(unscheduled != NULL);
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, +body, &call));
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == &errors);
+    for(cco_error error : errors) {
+        REQUIRE(error == CCO_ERROR_INVALID_CONTEXT);
+    }
+    // neither coroutine was disturbed
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(cco_coroutine_get_state(other) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(cco_coroutine_get_state(unscheduled) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_resume(other);
+    REQUIRE(cco_coroutine_get_state(other) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_coroutine_destroy(coroutine);
+    cco_coroutine_destroy(other);
+    cco_coroutine_destroy(unscheduled);
+}
+
+TEST_CASE("Test 42: A coroutine is run on a thread that was never set up", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    auto body = [](void*) {
+        cco_yield(reinterpret_cast<void*>(1));
+        cco_yield(reinterpret_cast<void*>(2));
+    };
+
+    struct observations {
+        cco_error           yield_error  = CCO_OK;
+        cco_error           resume_error = CCO_ERROR_INVALID_ARGUMENT;
+        bool                acquired     = false;
+        void*               value        = NULL;
+        cco_coroutine_state state        = CCO_COROUTINE_STATE_RUNNING;
+    };
+
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    REQUIRE(cco_coroutine_start(coroutine, +body, NULL));
+    REQUIRE(cco_coroutine_get_return_value(coroutine) == reinterpret_cast<void*>(1));
+
+    // resumed without cco_thread_init(), after a rejected switch out of the thread's own context
+    observations resumed;
+    REQUIRE(cco_coroutine_release(coroutine));
+    std::thread([&resumed, coroutine] {
+        cco_yield(NULL);
+        resumed.yield_error = cco_errno;
+        resumed.acquired    = cco_coroutine_acquire(coroutine);
+        cco_resume(coroutine);
+        resumed.resume_error = cco_errno;
+        resumed.value        = cco_coroutine_get_return_value(coroutine);
+        resumed.state        = cco_coroutine_get_state(coroutine);
+        cco_coroutine_release(coroutine);
+    }).join();
+    REQUIRE(resumed.yield_error == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(resumed.acquired);
+    REQUIRE(resumed.resume_error == CCO_OK);
+    REQUIRE(resumed.value == reinterpret_cast<void*>(2));
+    REQUIRE(resumed.state == CCO_COROUTINE_STATE_SUSPENDED);
+
+    // handed over by the creation of the thread instead of a release: the switches fail until the thread is set up
+    observations   finished;
+    cco_error      rejected_resume = CCO_OK, rejected_start = CCO_OK, rejected_await = CCO_OK, rejected_await_with = CCO_OK;
+    void*          rejected_value  = reinterpret_cast<void*>(1);
+    cco_coroutine* unstarted       = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(unstarted != NULL);
+    REQUIRE(cco_coroutine_acquire(coroutine));
+    std::thread([&, coroutine, unstarted] {
+        rejected_value  = cco_resume_with(coroutine, NULL);
+        rejected_resume = cco_errno;
+        cco_coroutine_start(unstarted, +body, NULL);
+        rejected_start = cco_errno;
+        cco_await(NULL);
+        rejected_await = cco_errno;
+        cco_await_with(cco_await_ready, NULL, NULL);
+        rejected_await_with = cco_errno;
+        cco_thread_init();
+        finished.value        = cco_resume_with(coroutine, NULL);
+        finished.resume_error = cco_errno;
+        finished.state        = cco_coroutine_get_state(coroutine);
+    }).join();
+    REQUIRE(rejected_resume == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(rejected_value == NULL);
+    REQUIRE(rejected_start == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(rejected_await == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(rejected_await_with == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(finished.resume_error == CCO_OK);
+    REQUIRE(finished.value == NULL);
+    REQUIRE(finished.state == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_coroutine_destroy(coroutine);
+    cco_coroutine_destroy(unstarted);
+}
+
+TEST_CASE("Test 43: The scheduler queues a coroutine at most once", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 65536;
+
+    static cco_scheduler*   scheduler;
+    static cco_coroutine*   yielding;
+    static cco_error        wake_error;
+    static std::vector<int> log;
+
+    auto parked = [](void* arg) {
+        log.push_back(-1);
+        cco_await_with(NULL, cco_scheduler_park, NULL);
+        log.push_back(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+    };
+    auto yielder = [](void*) {
+        log.push_back(1);
+        cco_scheduler_yield(scheduler);
+        log.push_back(3);
+    };
+    auto waker = [](void*) {
+        // woken while queued after yielding
+        log.push_back(2);
+        cco_scheduler_wake(scheduler, yielding);
+        wake_error = cco_errno;
+    };
+
+    scheduler = cco_scheduler_create();
+    REQUIRE(scheduler != NULL);
+    cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(coroutine != NULL);
+    yielding = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(yielding != NULL);
+    cco_coroutine* other = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(other != NULL);
+
+    // spawned twice
+    REQUIRE(cco_spawn(scheduler, coroutine, +parked, reinterpret_cast<void*>(intptr_t(42))));
+    REQUIRE(!cco_spawn(scheduler, coroutine, +parked, reinterpret_cast<void*>(intptr_t(43))));
+    REQUIRE(cco_errno == CCO_ERROR_SCHEDULED);
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1});
+
+    // woken twice
+    cco_scheduler_wake(scheduler, coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+    cco_scheduler_wake(scheduler, coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1, 42});
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // woken after yielding
+    log.clear();
+    REQUIRE(cco_spawn(scheduler, yielding, +yielder, NULL));
+    REQUIRE(cco_spawn(scheduler, other, +waker, NULL));
+    REQUIRE(cco_scheduler_run(scheduler) == 3);
+    REQUIRE(wake_error == CCO_OK);
+    REQUIRE(log == std::vector<int>{1, 2, 3});
+    REQUIRE(cco_coroutine_get_state(yielding) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // woken, then resumed by hand until it returns: not started again
+    log.clear();
+    REQUIRE(cco_spawn(scheduler, coroutine, +parked, reinterpret_cast<void*>(intptr_t(7))));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    cco_scheduler_wake(scheduler, coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+    cco_resume(coroutine);
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_scheduler_run(scheduler) == 0);
+    REQUIRE(log == std::vector<int>{-1, 7});
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // spawned, then started by hand: resumed rather than started again
+    log.clear();
+    REQUIRE(cco_spawn(scheduler, coroutine, +parked, reinterpret_cast<void*>(intptr_t(8))));
+    REQUIRE(cco_coroutine_start(coroutine, +parked, reinterpret_cast<void*>(intptr_t(9))));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1, 9});
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // woken by another scheduler while queued: left to the first one
+    log.clear();
+    cco_scheduler* second = cco_scheduler_create();
+    REQUIRE(second != NULL);
+    REQUIRE(cco_spawn(scheduler, coroutine, +parked, reinterpret_cast<void*>(intptr_t(10))));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    cco_scheduler_wake(scheduler, coroutine);
+    REQUIRE(cco_errno == CCO_OK);
+    cco_scheduler_wake(second, coroutine);
+    REQUIRE(cco_errno == CCO_ERROR_SCHEDULED);
+    REQUIRE(cco_scheduler_run(second) == 0);
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(log == std::vector<int>{-1, 10});
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_scheduler_destroy(second);
+
+    cco_coroutine_destroy(coroutine);
+    cco_coroutine_destroy(yielding);
+    cco_coroutine_destroy(other);
+    cco_scheduler_destroy(scheduler);
+}
+
+TEST_CASE("Test 44: The scheduler drops the coroutines it cannot switch to", "[cco]")
+{
+    static cco_scheduler*   scheduler;
+    static cco_coroutine*   neighbour;
+    static size_t           runs;
+    static cco_error        error;
+    static std::vector<int> log;
+
+    auto logger = [](void* arg) {
+        log.push_back(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+    };
+    // runs the scheduler from a coroutine whose stack the spawned neighbour would overwrite
+    auto runner = [](void* arg) {
+        cco_coroutine_callback function = *static_cast<cco_coroutine_callback*>(arg);
+        REQUIRE(cco_spawn(scheduler, neighbour, function, reinterpret_cast<void*>(intptr_t(1))));
+        runs  = cco_scheduler_run(scheduler);
+        error = cco_errno;
+        log.push_back(2);
+    };
+    cco_coroutine_callback function = +logger;
+
+    scheduler = cco_scheduler_create();
+    REQUIRE(scheduler != NULL);
+    cco_shared_stack* stack = cco_shared_stack_create(65536);
+    REQUIRE(stack != NULL);
+    cco_coroutine* coroutine = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(coroutine != NULL);
+    neighbour = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(neighbour != NULL);
+
+    REQUIRE(cco_coroutine_start(coroutine, +runner, &function));
+    REQUIRE(runs == 0);
+    REQUIRE(error == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(log == std::vector<int>{2});
+    REQUIRE(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_state(neighbour) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // dropped, not lost: it can be spawned again, and runs from the main context
+    REQUIRE(cco_spawn(scheduler, neighbour, +logger, reinterpret_cast<void*>(intptr_t(3))));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(log == std::vector<int>{2, 3});
+
+    cco_coroutine_destroy(coroutine);
+    cco_coroutine_destroy(neighbour);
+    cco_shared_stack_destroy(stack);
+    cco_scheduler_destroy(scheduler);
+}
+
+TEST_CASE("Test 45: A switch which cannot save the frames on a shared stack fails", "[cco]")
+{
+    static bool exhausted = false;
+
+    cco_allocator allocator = {
+        [](void*, size_t size) { return exhausted ? nullptr : malloc(size); },
+        [](void*, void* ptr, size_t) { free(ptr); },
+        [](void*, size_t size, size_t alignment) {
+            void* ptr = nullptr;
+            return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+        },
+        [](void*, void* ptr, size_t) { free(ptr); },
+        [](void*, size_t size) { return malloc(size); },
+        [](void*, void* ptr, size_t) { free(ptr); },
+        nullptr,
+    };
+    // the frames live on the shared stack, and are checked once they are restored
+    auto body = [](void* arg) {
+        volatile uintptr_t frame = reinterpret_cast<uintptr_t>(arg);
+        cco_yield(NULL);
+        cco_yield(reinterpret_cast<void*>(frame));
+    };
+
+    cco_set_thread_allocator(&allocator);
+    cco_shared_stack* stack = cco_shared_stack_create(65536);
+    REQUIRE(stack != NULL);
+    cco_coroutine* first = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(first != NULL);
+    cco_coroutine* second = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(second != NULL);
+    cco_set_thread_allocator(NULL);
+
+    REQUIRE(cco_coroutine_start(first, +body, reinterpret_cast<void*>(uintptr_t(1))));
+
+    // the frames of the first one cannot be saved to start the second one
+    exhausted = true;
+    REQUIRE(!cco_coroutine_start(second, +body, reinterpret_cast<void*>(uintptr_t(2))));
+    REQUIRE(cco_errno == CCO_ERROR_NO_MEMORY);
+    REQUIRE(cco_coroutine_start_fast(second, +body, reinterpret_cast<void*>(uintptr_t(2))) == CCO_ERROR_NO_MEMORY);
+    REQUIRE(cco_coroutine_get_state(second) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    exhausted = false;
+    REQUIRE(cco_coroutine_start(second, +body, reinterpret_cast<void*>(uintptr_t(2))));
+
+    // nor can the frames of the second one to resume the first one
+    exhausted = true;
+    cco_resume(first);
+    REQUIRE(cco_errno == CCO_ERROR_NO_MEMORY);
+    REQUIRE(cco_resume_fast(first) == CCO_ERROR_NO_MEMORY);
+    REQUIRE(cco_coroutine_get_state(first) == CCO_COROUTINE_STATE_SUSPENDED);
+    exhausted = false;
+
+    // nothing was lost
+    cco_resume(first);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_coroutine_get_return_value(first) == reinterpret_cast<void*>(uintptr_t(1)));
+    cco_resume(second);
+    REQUIRE(cco_coroutine_get_return_value(second) == reinterpret_cast<void*>(uintptr_t(2)));
+    cco_resume(first);
+    cco_resume(second);
+    REQUIRE(cco_coroutine_get_state(first) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_state(second) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    // nor those holding the stack of the caller of an awaiting coroutine, which then is never published as suspended
+    static cco_coroutine* neighbour;
+    static cco_error      await_error;
+    static bool           published;
+    cco_set_thread_allocator(&allocator);
+    neighbour = cco_coroutine_create_shared(stack, NULL);
+    REQUIRE(neighbour != NULL);
+    cco_set_thread_allocator(NULL);
+    cco_coroutine* awaiting = cco_coroutine_create(65536, NULL);
+    REQUIRE(awaiting != NULL);
+    auto runner = [](void* arg) {
+        cco_coroutine_start(
+            static_cast<cco_coroutine*>(arg),
+            [](void*) {
+                cco_await_with(
+                    [](cco_coroutine*, void*) {
+                        // the caller loses the shared stack to a coroutine whose frames cannot be saved
+                        cco_coroutine_start(neighbour, [](void*) { cco_yield(NULL); }, NULL);
+                        exhausted = true;
+                        return false;
+                    },
+                    [](cco_coroutine*, void*) { return published = true; },
+                    NULL
+                );
+                await_error = cco_errno;
+                exhausted   = false;
+            },
+            NULL
+        );
+    };
+    REQUIRE(cco_coroutine_start(first, +runner, awaiting));
+    REQUIRE(await_error == CCO_ERROR_NO_MEMORY);
+    REQUIRE(!published);
+    REQUIRE(cco_coroutine_get_state(awaiting) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_state(first) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    REQUIRE(cco_coroutine_get_state(neighbour) == CCO_COROUTINE_STATE_SUSPENDED);
+    cco_resume(neighbour);
+    REQUIRE(cco_coroutine_get_state(neighbour) == CCO_COROUTINE_STATE_UNSCHEDULED);
+
+    cco_coroutine_destroy(awaiting);
+    cco_coroutine_destroy(neighbour);
+    cco_coroutine_destroy(first);
+    cco_coroutine_destroy(second);
+    cco_shared_stack_destroy(stack);
+}
+
+TEST_CASE("Test 46: A queued coroutine is neither destroyed nor recycled", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 16384;
+
+    static int runs;
+
+    auto body = [](void*) {
+        ++runs;
+    };
+
+    cco_scheduler* scheduler = cco_scheduler_create();
+    REQUIRE(scheduler != NULL);
+    cco_pool* pool = cco_pool_create(NULL, CCO_COROUTINE_FLAGS_DEFAULT, 1);
+    REQUIRE(pool != NULL);
+    cco_coroutine* spawned = cco_pool_acquire(pool, STACK_SIZE);
+    REQUIRE(spawned != NULL);
+    cco_coroutine* other = cco_pool_acquire(pool, STACK_SIZE);
+    REQUIRE(other != NULL);
+
+    REQUIRE(cco_spawn(scheduler, spawned, +body, NULL));
+    REQUIRE(cco_spawn(scheduler, other, +body, NULL));
+    cco_coroutine_destroy(spawned);
+    REQUIRE(cco_errno == CCO_ERROR_SCHEDULED);
+    cco_pool_release(pool, spawned);
+    REQUIRE(cco_errno == CCO_ERROR_SCHEDULED);
+    // the queue is intact, and the coroutine is not in the pool
+    cco_coroutine* fresh = cco_pool_acquire(pool, STACK_SIZE);
+    REQUIRE(fresh != NULL);
+    REQUIRE(fresh != spawned);
+    REQUIRE(cco_scheduler_run(scheduler) == 2);
+    REQUIRE(runs == 2);
+
+    // released once it left the queue, and queued again once acquired
+    cco_pool_release(pool, spawned);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_pool_acquire(pool, STACK_SIZE) == spawned);
+    REQUIRE(cco_spawn(scheduler, spawned, +body, NULL));
+    REQUIRE(cco_scheduler_run(scheduler) == 1);
+    REQUIRE(runs == 3);
+
+    // a scheduler destroyed with coroutines in its queue lets them go
+    REQUIRE(cco_spawn(scheduler, other, +body, NULL));
+    cco_scheduler_destroy(scheduler);
+    cco_coroutine_destroy(other);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(runs == 3);
+
+    cco_coroutine_destroy(spawned);
+    cco_coroutine_destroy(fresh);
+    cco_pool_destroy(pool);
+}
+
+TEST_CASE("Test 47: A released coroutine is neither run nor destroyed until acquired", "[cco]")
+{
+    static constexpr size_t STACK_SIZE = 16384;
+
+    static cco_coroutine* released;
+    static cco_error      transfer_error;
+    static void*          transfer_value;
+
+    auto yielding = [](void*) {
+        cco_yield(reinterpret_cast<void*>(1));
+        cco_return(reinterpret_cast<void*>(2));
+    };
+    auto transferring = [](void*) {
+        transfer_value = cco_transfer(released, reinterpret_cast<void*>(3));
+        transfer_error = cco_errno;
+    };
+
+    cco_pool* pool = cco_pool_create(NULL, CCO_COROUTINE_FLAGS_DEFAULT, 1);
+    REQUIRE(pool != NULL);
+    released = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(released != NULL);
+    cco_coroutine* unstarted = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(unstarted != NULL);
+    cco_coroutine* transferrer = cco_coroutine_create(STACK_SIZE, NULL);
+    REQUIRE(transferrer != NULL);
+
+    // the thread which released them does not own them any longer either
+    REQUIRE(cco_coroutine_start(released, +yielding, NULL));
+    REQUIRE(cco_coroutine_release(released));
+    REQUIRE(cco_coroutine_release(unstarted));
+    cco_resume(released);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_resume_with(released, reinterpret_cast<void*>(3)) == NULL);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(!cco_coroutine_start(unstarted, +yielding, NULL));
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_coroutine_start(transferrer, +transferring, NULL));
+    REQUIRE(transfer_error == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(transfer_value == NULL);
+    cco_coroutine_destroy(released);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    cco_pool_release(pool, unstarted);
+    REQUIRE(cco_errno == CCO_ERROR_INVALID_CONTEXT);
+    REQUIRE(cco_coroutine_get_state(released) == CCO_COROUTINE_STATE_SUSPENDED);
+    REQUIRE(cco_coroutine_get_state(unstarted) == CCO_COROUTINE_STATE_UNSCHEDULED);
+    cco_coroutine* fresh = cco_pool_acquire(pool, STACK_SIZE);
+    REQUIRE(fresh != NULL);
+    REQUIRE(fresh != unstarted);
+
+    // acquired again, they are run and destroyed as usual
+    REQUIRE(cco_coroutine_acquire(released));
+    REQUIRE(cco_coroutine_acquire(unstarted));
+    cco_resume(released);
+    REQUIRE(cco_errno == CCO_OK);
+    REQUIRE(cco_coroutine_get_return_value(released) == reinterpret_cast<void*>(2));
+    REQUIRE(cco_coroutine_start(unstarted, +yielding, NULL));
+    REQUIRE(cco_coroutine_get_return_value(unstarted) == reinterpret_cast<void*>(1));
+    cco_coroutine_destroy(released);
+    REQUIRE(cco_errno == CCO_OK);
+    cco_pool_release(pool, unstarted);
+    REQUIRE(cco_errno == CCO_OK);
+
+    cco_coroutine_destroy(transferrer);
+    cco_coroutine_destroy(fresh);
+    cco_pool_destroy(pool);
+}
@@ -34,40 +34,59 @@
 
 cco_coroutine* coroutines[2];
 
-void
+void*
 hello(void* arg)
 {
     printf("Hello from %s\n", (const char*)arg);
+    return NULL;
 }
 
-void
-hello_inner(const char* arg, int i)
+struct hello_args {
+    const char* name;
+    int         i;
+};
+
+void*
+hello_inner(void* arg)
 {
-    printf("Hello from %s (%d)\n", arg, i);
+    const struct hello_args* args = (const struct hello_args*)arg;
+    printf("Hello from %s (%d)\n", args->name, args->i);
+    printf("Coroutine 0 state: %s\n", cco_coroutine_state_strings[cco_coroutine_get_state(coroutines[0])]);
+    printf("Coroutine 1 state: %s\n", cco_coroutine_state_strings[cco_coroutine_get_state(coroutines[1])]);
+    return NULL;
+}
+
+void*
+goodbye(void* arg)
+{
+    printf("Goodbye from %s\n", (const char*)arg);
+    return NULL;
 }
 
 void
 hello_loop(void* arg)
 {
     for(int i = 0; i != 10; ++i) {
-        hello_inner((const char*)arg, i);
-        printf("Coroutine 0 state: %s\n", cco_coroutine_state_strings[cco_coroutine_get_state(coroutines[0])]);
-        printf("Coroutine 1 state: %s\n", cco_coroutine_state_strings[cco_coroutine_get_state(coroutines[1])]);
+        struct hello_args args = {(const char*)arg, i};
+        cco_call_on_big_stack(hello_inner, &args);
         cco_yield(&i);
     }
-    printf("Goodbye from %s\n", (const char*)arg);
+    cco_call_on_big_stack(goodbye, arg);
 }
 
 int
 main(void)
 {
     for(int i = 0; i != 2; ++i) {
-        /*  Values below 4096 crash when trying to use printf. I suspect printf allocates some buffer on the stack,
-            and using a stack that is too small causes a stack overflow.
+        /*  printf needs a few KiB of stack, far more than the coroutines themselves: they call it on the big stack of
+            the thread, hence their own stacks can be this small.
         */
-        coroutines[i] = cco_coroutine_create(4096, NULL);
+        coroutines[i] = cco_coroutine_create(1024, NULL);
     }
 
+    /*  The first call maps the big stack from the stack of the caller, which takes a few KiB as well. */
+    cco_call_on_big_stack(hello, "main");
+
     cco_coroutine_start(coroutines[0], hello_loop, "coroutine 0");
     cco_coroutine_start(coroutines[1], hello_loop, "coroutine 1");
 
@@ -0,0 +1,276 @@
+/*
+ *   cco - coroutine library for C
+ *   Copyright (C) 2022 Domenico Teodonio at dteod@protonmail.com
+ *
+ *   cco is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   cco is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with cco.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file test/x86_64.c
+ *
+ * @brief Test file for x86_64 architecture.
+ *
+ * @details Checks the properties of the x86_64 context switch that the black box test cannot observe: the ABI stack
+ * alignment at the coroutine entry, the callee-saved registers across switches and the optional register exchanges.
+ */
+
+#include "cco.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <xmmintrin.h>
+
+#define STACK_SIZE (4096 * 4)
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                                                         \
+  do {                                                                                                                           \
+    if(!(condition)) {                                                                                                           \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                                                       \
+      ++failures;                                                                                                                \
+    }                                                                                                                            \
+  } while(0)
+
+static void
+check_alignment(void* arg)
+{
+    /* The ABI requires %rsp + 8 to be 16-byte aligned at function entry, hence the frame address is 16-byte aligned. */
+    *(uintptr_t*)arg = (uintptr_t)__builtin_frame_address(0);
+}
+
+static void
+accumulate(void* arg)
+{
+    /* Enough live values to spill into every callee-saved register across the yields. */
+    volatile uint64_t* out = (volatile uint64_t*)arg;
+    uint64_t           a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7;
+    for(int i = 0; i != 16; ++i) {
+        a += b;
+        b ^= c << 1;
+        c += d * 3;
+        d ^= e + i;
+        e += f;
+        f ^= g >> 1;
+        g += a;
+        cco_yield(NULL);
+    }
+    *out = a ^ b ^ c ^ d ^ e ^ f ^ g;
+}
+
+static uint64_t
+accumulate_reference(void)
+{
+    uint64_t a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7;
+    for(int i = 0; i != 16; ++i) {
+        a += b;
+        b ^= c << 1;
+        c += d * 3;
+        d ^= e + i;
+        e += f;
+        f ^= g >> 1;
+        g += a;
+    }
+    return a ^ b ^ c ^ d ^ e ^ f ^ g;
+}
+
+#if CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE
+static void
+keep_rounding_mode(void* arg)
+{
+    _mm_setcsr((_mm_getcsr() & ~0x6000u) | 0x2000u); /* round toward negative infinity */
+    cco_yield(NULL);
+    *(unsigned int*)arg = _mm_getcsr() & 0x6000u;
+}
+#endif
+
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE || CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE
+static unsigned short
+get_fpucw(void)
+{
+    unsigned short cw;
+    __asm__ volatile("fnstcw %0" : "=m"(cw));
+    return cw;
+}
+
+static void
+set_fpucw(unsigned short cw)
+{
+    __asm__ volatile("fldcw %0" : : "m"(cw));
+}
+
+static void
+keep_control_words(void* arg)
+{
+    _mm_setcsr((_mm_getcsr() & ~0x6000u) | 0x2000u); /* round toward negative infinity */
+    set_fpucw((get_fpucw() & ~0x0c00u) | 0x0400u);   /* same for the x87 unit */
+    cco_yield(NULL);
+    ((unsigned int*)arg)[0] = _mm_getcsr() & 0x6000u;
+    ((unsigned int*)arg)[1] = get_fpucw() & 0x0c00u;
+}
+#endif
+
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+static void
+record_control_words(void* arg)
+{
+    ((unsigned int*)arg)[0] = _mm_getcsr() & 0x6000u;
+    ((unsigned int*)arg)[1] = get_fpucw() & 0x0c00u;
+}
+
+/* A bare coroutine started from a coroutine owning the control words runs with those of the outer context. */
+static void
+start_bare(void* arg)
+{
+    unsigned int*  words = (unsigned int*)arg;
+    cco_coroutine* bare  = cco_coroutine_create(STACK_SIZE, NULL);
+    _mm_setcsr((_mm_getcsr() & ~0x6000u) | 0x2000u);
+    set_fpucw((get_fpucw() & ~0x0c00u) | 0x0400u);
+    if(bare && cco_coroutine_start(bare, record_control_words, words)) {
+        words[2] = _mm_getcsr() & 0x6000u;
+        words[3] = get_fpucw() & 0x0c00u;
+    }
+    cco_coroutine_destroy(bare);
+}
+#endif
+
+#if CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE
+/* The compiler cannot keep a vector register live across a call: %ymm8 is written and read back explicitly. */
+static void
+set_ymm8(uint64_t value)
+{
+    uint64_t lanes[4] = {value, value, value, value};
+    __asm__ volatile("vmovdqu %0, %%ymm8" : : "m"(lanes) : "xmm8");
+}
+
+static uint64_t
+get_ymm8_upper(void)
+{
+    uint64_t lanes[4];
+    __asm__ volatile("vmovdqu %%ymm8, %0" : "=m"(lanes));
+    return lanes[3];
+}
+
+static void
+keep_ymm8(void* arg)
+{
+    set_ymm8(0x0123456789abcdefu);
+    cco_yield(NULL);
+    *(uint64_t*)arg = get_ymm8_upper();
+}
+#endif
+
+int
+main(void)
+{
+    {
+        uintptr_t      frame     = 0;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, check_alignment, &frame));
+        CHECK(frame != 0 && frame % 16 == 0);
+        cco_coroutine_destroy(coroutine);
+    }
+
+    {
+        uint64_t       result    = 0;
+        cco_coroutine* coroutine = cco_coroutine_create(STACK_SIZE, NULL);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, accumulate, &result));
+        while(cco_coroutine_get_state(coroutine) == CCO_COROUTINE_STATE_SUSPENDED) {
+            cco_resume(coroutine);
+        }
+        CHECK(result == accumulate_reference());
+        cco_coroutine_destroy(coroutine);
+    }
+
+#if CCO_x86_64_ENABLE_SSE_REGISTERS_EXCHANGE
+    {
+        const cco_architecture_specific_settings settings  = CCO_SETTINGS_x86_64_EXCHANGE_SSE_REGISTERS;
+        const unsigned int                       mxcsr     = _mm_getcsr();
+        const unsigned short                     fpucw     = get_fpucw();
+        unsigned int                             rounding  = 0;
+        cco_coroutine*                           coroutine = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_rounding_mode, &rounding));
+        /* the rounding mode of the coroutine does not leak into the main context */
+        CHECK(_mm_getcsr() == mxcsr);
+        CHECK(get_fpucw() == fpucw);
+        _mm_setcsr((_mm_getcsr() & ~0x6000u) | 0x6000u); /* round toward zero in the main context */
+        cco_resume(coroutine);
+        CHECK(rounding == 0x2000u);
+        CHECK((_mm_getcsr() & 0x6000u) == 0x6000u);
+        _mm_setcsr(mxcsr);
+        cco_coroutine_destroy(coroutine);
+    }
+#endif
+
+#if CCO_x86_64_ENABLE_FP_CONTROL_REGISTERS_EXCHANGE
+    {
+        const cco_architecture_specific_settings settings    = CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS;
+        const unsigned int                       mxcsr       = _mm_getcsr();
+        const unsigned short                     fpucw       = get_fpucw();
+        unsigned int                             rounding[2] = {0, 0};
+        cco_coroutine*                           coroutine   = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_control_words, rounding));
+        /* the control words of the coroutine do not leak into the main context */
+        CHECK(_mm_getcsr() == mxcsr);
+        CHECK(get_fpucw() == fpucw);
+        _mm_setcsr((_mm_getcsr() & ~0x6000u) | 0x6000u); /* round toward zero in the main context */
+        set_fpucw(fpucw | 0x0c00u);
+        cco_resume(coroutine);
+        CHECK(rounding[0] == 0x2000u);
+        CHECK(rounding[1] == 0x0400u);
+        CHECK((_mm_getcsr() & 0x6000u) == 0x6000u);
+        CHECK((get_fpucw() & 0x0c00u) == 0x0c00u);
+        _mm_setcsr(mxcsr);
+        set_fpucw(fpucw);
+        cco_coroutine_destroy(coroutine);
+    }
+
+    {
+        const cco_architecture_specific_settings settings  = CCO_SETTINGS_x86_64_EXCHANGE_FP_CONTROL_REGISTERS;
+        const unsigned int                       mxcsr     = _mm_getcsr();
+        const unsigned short                     fpucw     = get_fpucw();
+        unsigned int                             words[4]  = {0, 0, 0, 0};
+        cco_coroutine*                           coroutine = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, start_bare, words));
+        CHECK(words[0] == (mxcsr & 0x6000u));
+        CHECK(words[1] == (fpucw & 0x0c00u));
+        CHECK(words[2] == 0x2000u);
+        CHECK(words[3] == 0x0400u);
+        CHECK(_mm_getcsr() == mxcsr);
+        CHECK(get_fpucw() == fpucw);
+        cco_coroutine_destroy(coroutine);
+    }
+#endif
+
+#if CCO_x86_64_ENABLE_AVX_REGISTERS_EXCHANGE
+    if(__builtin_cpu_supports("avx")) {
+        const cco_architecture_specific_settings settings  = CCO_SETTINGS_x86_64_EXCHANGE_AVX_REGISTERS;
+        uint64_t                                 upper     = 0;
+        cco_coroutine*                           coroutine = cco_coroutine_create(STACK_SIZE, &settings);
+        CHECK(coroutine != NULL);
+        CHECK(cco_coroutine_start(coroutine, keep_ymm8, &upper));
+        set_ymm8(0xfedcba9876543210u); /* clobbered by the main context while the coroutine is suspended */
+        cco_resume(coroutine);
+        CHECK(upper == 0x0123456789abcdefu);
+        cco_coroutine_destroy(coroutine);
+    }
+#endif
+
+    return failures != 0;
+}